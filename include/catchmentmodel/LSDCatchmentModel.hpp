@@ -7,6 +7,7 @@
 #include <string>
 #include <array>
 #include <map>
+#include <utility>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
@@ -21,6 +22,15 @@
 
 #include "LSDGrainMatrix.hpp"
 #include "LSDRainfallRunoff.hpp"
+#include "LSDGrid.hpp"         // Flat, aligned grids for the hot model state
+#include "LSDFlowKernels.hpp"  // Vectorised LISFLOOD kernels
+#include "LSDTileMap.hpp"      // Domain tiles, to skip dry or no data areas
+#include "LSDPrecision.hpp"    // hydro_real, the storage type of the flow state
+#include "LSDKernelOptions.hpp" // Option policies for the templated kernels
+#include "LSDWorkPartition.hpp" // Load balanced chunks for the OpenMP loops
+#include "LSDPlacement.hpp"     // Thread pinning and NUMA page placement
+#include "LSDGrainPool.hpp"     // Grain size and strata records, allocated as needed
+#include "LSDTransportTables.hpp" // Tabulated sediment transport functions
 #include "TNT/tnt.h"   // Template Numerical Toolkit library: used for 2D Arrays.
 
 #ifndef LSDCatchmentModel_H
@@ -95,6 +105,9 @@ public:
   /// @brief Is this a hydrology only simulation?
   /// I.e. no erosion methods.
   bool is_hydro_only() const { return hydro_only; }
+  bool hydro_step_fused() const { return fuse_hydro_step; }
+  /// @brief Is the flow field frozen? (see check_quasi_steady())
+  bool hydro_frozen() const { return quasi_steady_frozen; }
   bool groundwater_mode() const { return groundwater_on; }
   bool groundwater_basic_model() const { return groundwater_basic; }
   bool groundwater_SLiM_model() const { return groundwater_SLiM; }
@@ -182,8 +195,19 @@ public:
 
   void increment_counters();
 
+  /// @brief The morphological time at model time model_cycle (both in
+  /// minutes): the time the landscape has evolved for, which runs
+  /// morphological_factor times as fast as the model time.
+  double morphological_time(double model_cycle) const;
+
   void print_cycle();
 
+  /// @brief Prints the throughput of the flow routing and depth update
+  /// kernels (wet cells processed per second of wall clock time).
+  /// @details Used by the benchmark scripts in test/ to compare the
+  /// column-wise and row-major traversal orders.
+  void print_hydro_throughput();
+
   double get_cycle() const { return cycle; }
   int get_maxcycle() const { return maxcycle; }
 
@@ -248,12 +272,50 @@ public:
 
   /// @brief Apportions the erosion amount to the grain
   /// size distribution fractions.
+  /// @details Takes the next grain size record with an atomic increment,
+  /// so it can be called from several threads at once.
   void addGS(int x, int y);
 
+  /// @brief Makes grain size record slot the record of cell (x, y), with the
+  /// default mixture in the active layer and strata.
+  void init_GS(int x, int y, int slot);
+
   /// @brief Determines which grain size fractions are moved to
   /// neigbouring cells during erosion routines.
   void slide_GS(int x,int y, double amount,int x2, int y2);
 
+  /// @brief The giving half of slide_GS(): takes amount of material from
+  /// cell (x, y) and writes the volume of each grain size taken to
+  /// moved[1..G_MAX-1], for the receiving cell to add. Only touches
+  /// cell (x, y).
+  void take_GS(int x, int y, double amount, double* moved);
+
+  /// @brief Gives a grain size record to every wet cell erode() works on,
+  /// and to the wet neighbours it can send sediment to, that has none yet.
+  /// @details Each column first counts its new cells, then the records
+  /// are numbered column by column and each column sets up its own. No
+  /// locks are taken, and the numbering does not depend on the number of
+  /// threads.
+  void add_new_GS();
+
+  /// @brief The cells of column y that add_new_GS() looks at. With
+  /// assign false, marks those with no record and counts them in counter;
+  /// with assign true, gives the marked ones records counter+1, ...
+  void new_GS_in_column(int y, bool assign, int& counter);
+  void new_GS_cell(int x, int y, bool assign, int& counter);
+
+  /// @brief Lateral (bank) erosion of erode(), along x (dx = 1) or
+  /// y (dy = 1).
+  /// @details Every eroding cell takes material from the banks on either
+  /// side of it along the direction. This is done in three passes, so that
+  /// each pass writes only to the cells (or faces) it is working on and the
+  /// result does not depend on the number of threads or the order of the
+  /// cells: the amounts taken across each face are worked out from the
+  /// elevations at the start, then each bank gives up its material
+  /// (take_GS()), then each eroding cell adds what it took.
+  void lateral_erosion(int dx, int dy, const TNT::Array2D<double>& erodetot3,
+                       double mult_factor);
+
   /// @brief (Used only in lateral channel erosion - under test)
   /// @returns "elevtot" or zero.
   double mean_ws_elev(int x, int y);
@@ -265,6 +327,22 @@ public:
   /// @author DAV
   double erode(double mult_factor);
 
+  /// @brief One step of erode(), over erosion_step * mult_factor seconds.
+  /// @details Shortens erosion_step until no cell erodes more than the
+  /// erosion limit.
+  /// @return The deepest erosion of any cell.
+  double erode_step(double mult_factor);
+
+  /// @brief The entrainment rates of erode() (Tau, erosion_rate and
+  /// erosion_weight), templated on the option policy.
+  template <class Options> void erosion_rates();
+
+  /// @brief The entrainment pass of erode(): scales the rates to the time
+  /// step and works out the sediment transfers, templated on the option
+  /// policy.
+  /// @return The deepest erosion of any cell.
+  template <class Options> double erosion_transfers(double mult_factor);
+
   /// @brief carries out the lateral bank erosion.
   /// @details This is quite computationall expensive and may be
   /// turned off in environments not susceptible to meandering. (bedrock
@@ -272,11 +350,21 @@ public:
   void lateral_channel_erode();
 
   /// @brief Sets the fall velocities of suspended sediment.
-  /// @details These are hard coded. Should be set up to read from
-  /// an sediment properties input file at a later stage.
+  /// @details From the fall_velocities parameter, or hard coded for the
+  /// default grain sizes.
   /// @author DAV
   void set_fall_velocities();
 
+  /// @brief Works out the per fraction constants of the sediment transport
+  /// laws, and builds the transport tables if transport_table_tolerance
+  /// is set (see LSDTransportTables.hpp).
+  void set_transport_constants();
+
+  /// @brief Checks the grain_sizes, grain_proportions and fall_velocities
+  /// parameters agree on the number of fractions, and that it and
+  /// strata_layers are in range. Stops the program if not.
+  void check_grain_sizes();
+
   // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
   // SLOPE PROCESS COMPONENTS
   // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -286,14 +374,47 @@ public:
   /// @detail I.e. removes material in channel
   /// when neighbouring pixels have gradient between them greater
   /// than critical angle.
+  /// With coloured_channel_landsliding, the columns are done in three
+  /// colour classes, each in parallel.
   void in_channel_landsliding();
 
+  /// @brief Does the landslide routine of in_channel_landsliding() for
+  /// one cell, against each of its eight neighbours in turn.
+  /// @param factor the height difference at the failure angle
+  /// @return true if any material was moved
+  bool in_channel_slide_cell(int x, int y, double factor);
+
+  /// @brief Gives the grain size records of cells the slots first_slot+1,
+  /// first_slot+2, ... in turn, moving the records.
+  /// @details The cells (x * (jmax + 2) + y) must hold exactly those slots
+  /// between them.
+  void renumber_records(const std::vector<int>& cells, int first_slot);
+
   /// @brief Checks whether slopes have exceded critical failure angle
   /// and if so, does a simple landslide routine.
   /// @details Lowers elevation of higher cell and deposits on lower cell
-  /// until gradient between two is below the critical angle.
+  /// until gradient between two is below the critical angle. Sweeps the
+  /// DEM until no slope is steeper than the failure angle (or for 200
+  /// sweeps). With landslide_worklist, each sweep only visits the cells
+  /// that could have become unstable since the last.
   void global_landsliding();
 
+  /// @brief Does the landslide routine of global_landsliding() for one
+  /// cell, against each of its eight neighbours in turn.
+  /// @param factor the height difference at the failure angle
+  /// @param total the material moved is added to this
+  /// @return true if any material was moved
+  bool slide_cell(int x, int y, double factor, double& total);
+
+  /// @brief Whether slide_cell() would move anything from this cell.
+  bool slope_unstable(int x, int y, double factor);
+
+  /// @brief Notes that the elevation (or bedrock) of a cell has changed,
+  /// so the next global_landsliding() tests it and its neighbours again.
+  /// @details Only for the thread working on the cell: the cell is
+  /// flagged, and listed by that thread.
+  void note_height_change(int x, int y);
+
   void call_global_landsliding(int global_landsliding_interval_hours);
 
   void call_channel_landsliding(int in_channel_landslide_iter_interval);
@@ -302,10 +423,55 @@ public:
   // method.)
   void slope_creep(int creep_time_interval_days, double creep_coeff);
 
+  /// @brief Soil creep: moves material to each lower neighbour at
+  /// CREEP_RATE * slope, over time (years), see hillslope_transport(),
+  /// or implicit_hillslope_diffusion() with implicit_creep.
   void creep( double );
 
+  /// @brief Soil erosion: like creep(), at SOIL_RATE * slope, weighted
+  /// by the square root of the drainage area.
   void soil_erosion( double time );
 
+  /// @brief Moves material from every cell above its bedrock to each
+  /// lower neighbour, (drop / distance^2) * rate * time of it (times
+  /// sqrt(area) if area_weighted), and its grain sizes with it.
+  /// @details What each cell sends is worked out once, into hillslope_out.
+  /// Each cell then gathers its own change from it, so the cells are done
+  /// in parallel. The grain sizes go through hillslope_grain_exchange().
+  void hillslope_transport(double rate, double time, bool area_weighted);
+
+  /// @brief The material hillslope_transport() moves from cell (x, y) to
+  /// each neighbour n (HILLSLOPE_DX/DY), in out[n], or -1 if it moves none
+  /// there. Returns whether it moves any.
+  bool hillslope_fluxes(int x, int y, double rate, double time,
+                        bool area_weighted, double* out);
+
+  /// @brief Linear diffusion of the same fluxes as hillslope_transport()
+  /// (without the area weighting), taken as one backward Euler step so it
+  /// is stable however long time is.
+  /// @details The implicit system is solved by a Jacobi preconditioned
+  /// conjugate gradient. The cells with no soil left to give are then
+  /// held at their bedrock by scaling down what they send, so no material
+  /// is made or lost. Returns the conjugate gradient iterations.
+  int implicit_hillslope_diffusion(double rate, double time);
+
+  /// @brief Makes hillslope_out and hillslope_senders ready for a step.
+  void start_hillslope_exchange();
+
+  /// @brief The grain size exchange of hillslope_transport(): slide_GS()
+  /// for every move in hillslope_out out of a cell with a grain size
+  /// record, in the order creep() always made them.
+  /// @details This is serial, so the grain totals do not change: its cost
+  /// is one slide_GS() per move, whatever the number of threads. Only the
+  /// cells in hillslope_senders are visited.
+  void hillslope_grain_exchange();
+
+  /// The hillslope_out entries of cell (x, y), one per neighbour n.
+  double* hillslope_sent(int x, int y)
+  {
+    return &hillslope_out[(static_cast<size_t>(x) * (jmax + 2) + y) * 8];
+  }
+
   void soil_development();
 
   // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -325,6 +491,100 @@ public:
   /// landscape. (i.e. this is the LISFLOOD algorithm)
   void flow_route();
 
+  /// @brief Rebuilds column_work and row_work from the wet lists, so each
+  /// chunk has about the same number of wet cells (see LSDWorkPartition).
+  /// Called whenever the wet lists are updated.
+  void rebuild_work_partitions();
+
+  /// @brief Pins the threads and moves the large model arrays onto the
+  /// memory nodes of the threads that work on them (first touch), as set
+  /// by thread_affinity and numa_first_touch, then prints the placement
+  /// report if asked for. Called once the data is loaded.
+  /// @details Each array is copied into a new buffer by the kernel thread
+  /// team, every thread writing the stripe of lines the static split gives
+  /// it: rows with row_major_traversal, columns otherwise.
+  void place_arrays();
+
+  /// @brief Picks the instantiations of the templated kernels
+  /// (flow_route_impl() etc.) for the options in the parameter file.
+  /// @details With specialised_kernels on, the options are compile time
+  /// constants of the instantiation picked (see LSDKernelOptions.hpp);
+  /// otherwise the generic LSDRuntimeOptions one is used, which tests
+  /// them for every cell. Called once the data is loaded.
+  void select_kernels();
+
+  /// @brief The flow_route() kernel, templated on the option policy.
+  template <class Options> void flow_route_impl();
+
+  /// @brief The depth_update() kernel, templated on the option policy.
+  template <class Options> void depth_update_impl();
+
+  /// @brief The fused_hydro_step() kernel, templated on the option policy.
+  template <class Options> void fused_hydro_step_impl();
+
+  /// @brief The LISFLOOD discharge update for the x and y faces of a
+  /// single cell. Called by flow_route() in either traversal order.
+  template <class Options>
+  void route_cell_flow(unsigned x, unsigned y, double flow_timestep,
+                       const Options& opts);
+
+  /// @brief The x face (x-1 to x) part of route_cell_flow().
+  template <class Options>
+  void route_face_x(unsigned x, unsigned y, double flow_timestep,
+                    double mannings, const Options& opts);
+
+  /// @brief The y face (y-1 to y) part of route_cell_flow().
+  template <class Options>
+  void route_face_y(unsigned x, unsigned y, double flow_timestep,
+                    double mannings, const Options& opts);
+
+  /// @brief Routes the wet cells of row x with the vectorised face kernel
+  /// picked at start up (see LSDFlowKernels.hpp).
+  /// @param hflow_x,hflow_y Per-thread scratch rows, jmax+2 long.
+  /// @return The number of cells routed.
+  long long route_row_vectorised(unsigned x, double flow_timestep,
+                                 std::vector<double>& hflow_x,
+                                 std::vector<double>& hflow_y);
+
+  /// @brief Routes the wet cells of row x (from cross_scan), with the
+  /// vectorised kernel if there is one, otherwise cell by cell.
+  /// @return The number of cells routed.
+  template <class Options>
+  long long route_row(unsigned x, double flow_timestep,
+                      std::vector<double>& hflow_x,
+                      std::vector<double>& hflow_y,
+                      const Options& opts);
+
+  /// @brief Updates the water depths (and suspended sediment) of the wet
+  /// cells of row x (from cross_scan).
+  /// @return The deepest water left in the row.
+  template <class Options>
+  double update_row_depth(unsigned x, double flow_timestep,
+                          const Options& opts);
+
+  /// @brief flow_route(), depth_update() and (in hydro only runs) the
+  /// edge outflow of water_flux_out() in a single pass over the domain.
+  /// @details The rows are worked through in bands, one band (a row of
+  /// domain tiles) per thread. Within a band the faces of row x+1 are
+  /// routed just before the depths of row x are updated, so both rows are
+  /// still in cache, and the maximum depth and edge outflow are gathered
+  /// on the way. The faces of row x+1 read the depths of row x, so they
+  /// must be routed before row x is updated: the first row of every band
+  /// (the halo of the band above) is routed before any band starts.
+  /// The results are identical to the separate calls.
+  void fused_hydro_step();
+
+  /// @brief Drains the water above the erosion threshold from the edge
+  /// cells of row x, recording the amounts in the edge_outflow arrays.
+  void drain_row_edges(unsigned x);
+
+  /// @brief Updates the water depth (and suspended sediment) of a single
+  /// cell from the face discharges.
+  /// @return The updated water depth, or zero if the cell is dry.
+  template <class Options>
+  double update_cell_depth(unsigned x, unsigned y, double flow_timestep,
+                           const Options& opts);
+
   /// @brief Wrapper that determines which water input routine to call,
   /// either the default one, or the object-based one with spatially complex
   /// runoff paterns.
@@ -390,11 +650,86 @@ public:
   /// catchment with minimal water content.
   void scan_area();
 
+  /// @brief Row-major version of scan_area(), used when the
+  /// row_major_traversal option is set.
+  /// @details Builds cross_scan, the row-wise list of wet cells, by
+  /// walking each row of water_depth in memory order (the inner index of
+  /// the TNT arrays). flow_route() and depth_update() then iterate rows in
+  /// the outer (parallel) loop and columns in the inner loop, so each
+  /// thread streams through contiguous memory rather than striding a whole
+  /// row between consecutive cells.
+  void scan_area_row_major();
+
+  /// @brief Incremental alternative to scan_area(), used when the
+  /// incremental_wet_scan option is set.
+  /// @details Rather than testing the 9-cell neighbourhood of every cell
+  /// in the domain, only the cells that can have changed depth since the
+  /// last call are checked: those in the current wet list (the only ones
+  /// depth_update() touches) and those noted by note_water_added(). When a
+  /// cell switches between dry and wet, the wet count of its neighbours is
+  /// updated, and cells whose count goes to or from zero are inserted into
+  /// or removed from down_scan / cross_scan in place. The lists come out
+  /// identical to the ones scan_area() would build.
+  void update_wet_frontier();
+
+  /// @brief Builds the wet state and neighbour counts used by
+  /// update_wet_frontier() from a full scan of the domain.
+  void rebuild_wet_frontier();
+
+  /// @brief Records that water was added to cell (x, y) outside of
+  /// depth_update(): its tile is flagged wet, and update_wet_frontier()
+  /// checks it. Only needed for cells that were dry at the last update.
+  void note_water_added(int x, int y)
+  {
+    tiles.mark_wet(x, y);
+    if (incremental_wet_scan && wet_frontier_built
+        && !wet_state[x][y] && !wet_pending[x][y])
+    {
+      wet_pending[x][y] = 1;
+      wet_pending_cells.push_back(std::make_pair(x, y));
+    }
+  }
+
+  /// @brief Rebuilds the wet flags and max depths of the domain tiles
+  /// from the wet lists. Called after every wet area check.
+  void refresh_tile_wet_state();
+
+  /// @brief Adds (delta = 1) or removes (delta = -1) a wet cell from the
+  /// neighbour counts, updating the wet lists where a count goes to or
+  /// from zero.
+  void shift_wet_neighbours(int x, int y, int delta);
+
   /// @brief Calculates water exiting from the catchment boundaries (on all
   /// four sides of the domain, regardles of where 'true' catchment outlet
   /// point is.)
   void water_flux_out();
 
+  /// @brief Freezes the flow field once it has stopped changing, and lets
+  /// it go again when it might change. Called once an iteration, after the
+  /// erosion and before water_flux_out(), so a frozen flow keeps the water
+  /// on the edge cells.
+  /// @details The flow is checked every quasi_steady_iterations
+  /// iterations. It is steady once water is going out, the share of the
+  /// inflow that did not go out over them is within quasi_steady_tolerance
+  /// of the share over the ones before, and qx and qy have changed by less
+  /// than that over them (the sum of the changes relative to the sum of the
+  /// discharges). While it is frozen, flow_route(), depth_update()
+  /// and water_flux_out() are not run and no water is added, so the
+  /// depths, discharges, velocities and outflow stay as they were, while
+  /// erosion and the slope processes carry on. The flow goes again as soon
+  /// as the inflow changes by more than the tolerance, or when the bed has
+  /// moved by more than quasi_steady_bed_change anywhere (checked every
+  /// quasi_steady_iterations iterations).
+  void check_quasi_steady();
+
+  /// @brief Moves the suspended sediment through the frozen flow field,
+  /// in place of flow_route() and depth_update().
+  void route_suspended_sediment();
+
+  /// @brief Copies qx and qy (with_elev: and elev) for
+  /// check_quasi_steady() to compare against.
+  void take_steady_snapshot(bool with_elev);
+
   /// @brief Calculates the difference between water entering the catchment
   /// and water leaving the catchment.
   /// If this value is below a user-set threshold, the timestep can be increased
@@ -441,7 +776,15 @@ private:
   const int ACTIVE_FACTOR=1;
   const int TRUE=1;
   const int FALSE=0;
-  const unsigned int G_MAX=10;
+  /// The number of grain size fractions + 1. The fractions are numbered
+  /// 1..G_MAX-1; entries 0 and G_MAX of a grain record are unused. Set by
+  /// grain_sizes (9 fractions by default).
+  unsigned int G_MAX=10;
+  /// The most grain size fractions the model takes (the size of the per
+  /// cell scratch arrays of the erosion code).
+  static const unsigned int MAX_FRACTIONS = 18;
+  /// The number of strata layers under the active layer of each cell.
+  unsigned int strata_layers = 10;
   const std::array<int, 9> deltaX = {{0,  0,  1,  1,  1,  0, -1, -1, -1}};
   const std::array<int, 9> deltaY = {{0, -1, -1,  0,  1,  1,  1,  0, -1}};
 
@@ -472,6 +815,8 @@ private:
   int counter=0;
 
   double waterinput = 0;
+  /// The water (m3/s) the reach inputs added in the last iteration.
+  double reach_inflow = 0;
   double waterOut = 0;
   double input_output_difference = 0;
   double in_out_difference_allowed = 0;
@@ -552,20 +897,29 @@ private:
   // KAtharine
   int variable_m_value_flag = 0;
 
-  // TO DO: DAV - these could be read from an input file.
-  // Swale grainsizes
-  double d1=0.000065;
-  double d2=0.001;
-  double d3=0.002;
-  double d4=0.004;
-  double d5=0.008;
-  double d6=0.016;
-  double d7=0.032;
-  double d8=0.064;
-  double d9=0.128;
-
-  // std::array<double, 11> dprop = {{0.0, 0.144, 0.022, 0.019, 0.029, 0.068, 0.146, 0.22, 0.231, 0.121, 0.0}}; // Default
-  double dprop[11] = {0.0, 0.05, 0.05, 0.15, 0.225, 0.25, 0.1, 0.075, 0.05, 0.05, 0.0}; // Swale
+  /// The grain size (m) of each fraction, grain_sizes[1..G_MAX-1], from
+  /// the grain_sizes parameter. Swale grainsizes by default.
+  std::vector<double> grain_sizes = {0.0, 0.000065, 0.001, 0.002, 0.004,
+                                     0.008, 0.016, 0.032, 0.064, 0.128, 0.0};
+
+  /// The proportion of each fraction in new sediment, dprop[1..G_MAX-1],
+  /// from the grain_proportions parameter.
+  // Default: {0.0, 0.144, 0.022, 0.019, 0.029, 0.068, 0.146, 0.22, 0.231, 0.121, 0.0}
+  std::vector<double> dprop = {0.0, 0.05, 0.05, 0.15, 0.225, 0.25, 0.1,
+                               0.075, 0.05, 0.05, 0.0}; // Swale
+
+  // Per fraction constants of the transport laws (set_transport_constants())
+  /// ln(grain_sizes[n])
+  std::vector<double> log_grain_sizes;
+  /// Einstein: (2650 - 1000) * Di, and sqrt(1000 / ((2250 - 1000) g Di^3))
+  std::vector<double> einstein_psi_size;
+  std::vector<double> einstein_settling;
+
+  /// The largest relative error allowed in the Wilcock and Crowe
+  /// transport tables; 0 uses the exact functions.
+  double transport_table_tolerance = 0.0;
+  bool use_transport_tables = false;
+  LSDWilcockTables wilcock_tables;
 
   double previous;
   int hours = 0;
@@ -595,29 +949,54 @@ private:
   std::vector<double> Qg_step, Qg_step2, Qg_hour, Qg_hour2;
   std::vector<double> Qg_over, Qg_over2, Qg_last,Qg_last2;
 
-  TNT::Array2D<double> elev;
-  TNT::Array2D<double> bedrock;
-  TNT::Array2D<double> init_elevs;
-  TNT::Array2D<double> water_depth;
-  TNT::Array2D<double> area;
-  TNT::Array2D<double> tempcreep;
-  TNT::Array2D<double> Tau;
-  TNT::Array2D<double> Vel;
-  TNT::Array2D<double> qx;
-  TNT::Array2D<double> qy;
-  TNT::Array2D<double> qxs;
-  TNT::Array2D<double> qys;
+  // The hot model state lives in flat, aligned LSDGrids (see LSDGrid.hpp).
+  // They index like the TNT arrays, [x][y], and carry a one cell halo
+  // beyond the (already padded) model domain. The flow state (depths,
+  // discharges, velocities, shear stress) is stored as hydro_real, which
+  // is float in a single precision build (see LSDPrecision.hpp).
+  LSDGrid<double> elev;
+  LSDGrid<double> bedrock;
+  LSDGrid<double> init_elevs;
+  LSDGrid<hydro_real> water_depth;
+  LSDGrid<double> area;
+  LSDGrid<double> tempcreep;
+  LSDGrid<hydro_real> Tau;
+  LSDGrid<hydro_real> Vel;
+  LSDGrid<hydro_real> qx;
+  LSDGrid<hydro_real> qy;
+  LSDGrid<double> qxs;
+  LSDGrid<double> qys;
+  LSDGrid<double> area_depth;
   // TODO - these are for the dune model which is as of yet unimplemented
-  TNT::Array2D<double> area_depth;
   TNT::Array2D<double> sand;
   TNT::Array2D<double> elev2;
   TNT::Array2D<double> sand2;
-  TNT::Array2D<double> grain;
-  TNT::Array2D<double> elev_diff;
-  TNT::Array2D<double> spat_var_mannings;
-
-  TNT::Array2D<int> index;
-  TNT::Array2D<int> down_scan;
+  /// Surface grain size records, grain[index[x][y]][n] (see LSDGrainPool.hpp)
+  LSDGrainPool grain;
+  LSDGrid<double> elev_diff;
+  LSDGrid<double> spat_var_mannings;
+
+  LSDGrid<int> index;
+  LSDGrid<int> down_scan;
+  /// Row-wise wet cell list (the transpose of down_scan): cross_scan[x][inc]
+  /// holds the wet columns of row x, zero terminated. Only used with
+  /// row_major_traversal.
+  LSDGrid<int> cross_scan;
+  /// Lengths of the down_scan / cross_scan lists, kept by
+  /// update_wet_frontier().
+  std::vector<int> down_scan_len;
+  std::vector<int> cross_scan_len;
+  /// Wet (depth > 0) state of each cell at the last frontier update.
+  LSDGrid<unsigned char> wet_state;
+  /// Number of wet cells in the 3x3 neighbourhood of each cell. A cell
+  /// is on the wet lists when this is non-zero.
+  LSDGrid<int> wet_neighbours;
+  /// Cells given water outside depth_update() since the last update.
+  LSDGrid<unsigned char> wet_pending;
+  std::vector< std::pair<int, int> > wet_pending_cells;
+  /// Fixed size tiles over the domain, flagging the ones with data and
+  /// the ones that may hold water, so whole-grid loops can skip the rest.
+  LSDTileMap tiles;
   TNT::Array2D<int> rfarea;
 
   // Reach input cell flag switches
@@ -651,22 +1030,45 @@ private:
   std::vector<int> catchment_input_x_coord;
   std::vector<int> catchment_input_y_coord;
 
-  TNT::Array3D<double> vel_dir;
-  TNT::Array3D<double> strata;
+  TNT::Array3D<hydro_real> vel_dir;
+  /// Strata records, strata[index[x][y]][z][n]
+  LSDStrataPool strata;
 
   std::vector<double> hourly_m_value;
   std::vector<double> temp_grain;
   
   TNT::Array3D<double> veg;
-  TNT::Array2D<double> edge, edge2; //TJC 27/1/05 array for edges
+  LSDGrid<double> edge, edge2; //TJC 27/1/05 array for edges
   std::vector<double> old_j_mean_store;
-  TNT::Array3D<double> sr, sl, su, sd;
-  TNT::Array2D<double> ss;
+  /// The bedload of each grain size each wet cell entrains in this time
+  /// step, bedload[x][y][n] (see erosion_transfers()). Its neighbour in
+  /// direction p gets bedload[x][y][n] * erosion_weight[x][y][p / 2].
+  TNT::Array3D<double> bedload;
+  LSDGrid<double> ss;
+  /// The entrainment rate of each grain size of each wet cell, per second
+  /// of erosion_step * mult_factor, erosion_rate[x][y][n] (see
+  /// erosion_rates()).
+  TNT::Array3D<double> erosion_rate;
+  /// The share of what a cell entrains that goes to its neighbour in
+  /// direction p (1 up, 3 right, 5 down or 7 left),
+  /// erosion_weight[x][y][p / 2].
+  TNT::Array3D<double> erosion_weight;
+  /// The cells of each column that erode their banks in erode()
+  /// (eroding_cells[y][1..]), zero terminated like down_scan.
+  LSDGrid<int> eroding_cells;
+  /// The lateral erosion exchange of lateral_erosion(): the amount each
+  /// cell takes from its bank on the low [0] and high [1] side, and the
+  /// volume of each grain size in it, [side * (G_MAX + 1) + n].
+  TNT::Array3D<double> lateral_take;
+  TNT::Array3D<double> lateral_grain;
 
   // MJ global vars
   std::vector<double> fallVelocity;
+  /// The fall_velocities parameter, indexed like grain_sizes (empty if not
+  /// given).
+  std::vector<double> fall_velocities;
   std::vector<bool> isSuspended;
-  TNT::Array2D<double> Vsusptot;
+  LSDGrid<double> Vsusptot;
 
 
   std::vector<int> nActualGridCells;
@@ -719,7 +1121,159 @@ private:
 
   bool spatially_complex_rainfall = false;
 
-  int erode_timestep_type = 0;  // 0 for default based on erosion amount, 1 for basedon hydro timestep
+  /// Walk the hydro kernels row by row (contiguous in memory) instead of
+  /// column by column.
+  bool row_major_traversal = false;
+
+  /// Vectorised flow routing: "no", "auto", "avx2" or "avx512"
+  std::string simd_flow_route = "no";
+  /// The face kernel picked for this CPU, NULL for the scalar code.
+  LSDFaceKernel face_kernel = NULL;
+
+  /// Edge length of the domain tiles, in cells
+  int tile_size = LSDTileMap::DEFAULT_TILE_SIZE;
+
+  /// Keep the wet lists up to date incrementally instead of rescanning
+  /// the whole domain.
+  bool incremental_wet_scan = false;
+  bool wet_frontier_built = false;
+  /// Number of cells on the wet lists, and the running totals used to
+  /// report the mean active fraction.
+  long long active_cells = 0;
+  double active_fraction_sum = 0.0;
+  long long active_fraction_samples = 0;
+
+  /// Do the hydro step in a single pass (see fused_hydro_step())
+  bool fuse_hydro_step = false;
+  /// Quasi-steady flow freezing (see check_quasi_steady()); a tolerance of
+  /// 0 turns it off.
+  double quasi_steady_tolerance = 0;
+  int quasi_steady_iterations = 100;
+  double quasi_steady_bed_change = 0.05;
+  bool quasi_steady_frozen = false;
+  /// Iterations since the last snapshot was taken or checked.
+  int quasi_steady_count = 0;
+  /// The inflow when the flow was frozen.
+  double frozen_inflow = 0;
+  /// The water (m3) that came in and went out since the last snapshot,
+  /// and the time (s) since then.
+  double steady_inflow_volume = 0;
+  double steady_outflow_volume = 0;
+  double steady_window_time = 0;
+  /// The time (s) the model moved on by in the last iteration.
+  double steady_last_step = 0;
+  /// The share of the inflow that did not go out over the last
+  /// quasi_steady_iterations iterations, -1 if there was no inflow.
+  double steady_gap = -1;
+  /// The snapshots of check_quasi_steady().
+  TNT::Array2D<double> steady_qx;
+  TNT::Array2D<double> steady_qy;
+  TNT::Array2D<double> steady_elev;
+  /// How many times the flow was frozen, and for how many iterations.
+  long long quasi_steady_freezes = 0;
+  long long frozen_iterations = 0;
+
+  /// Set when fused_hydro_step() has already drained the domain edges,
+  /// so water_flux_out() does not have to.
+  bool edges_drained = false;
+  /// Outflow (m3/s) through each edge cell in the last fused step: the
+  /// left (y = 1) and right (y = jmax) edge cells of each row, and the
+  /// top (x = 1) and bottom (x = imax) edge cells of each column.
+  std::vector<double> edge_outflow_left;
+  std::vector<double> edge_outflow_right;
+  std::vector<double> edge_outflow_top;
+  std::vector<double> edge_outflow_bottom;
+
+  /// How the column-wise and row-wise kernel loops share their lines out
+  /// between the threads, and the chunks they use.
+  LSDScheduleMode work_schedule = STATIC_SCHEDULE;
+  LSDWorkPartition column_work;
+  LSDWorkPartition row_work;
+
+  /// Copy the large arrays into buffers first touched by the threads
+  /// that use them (see place_arrays()).
+  bool numa_first_touch = false;
+  /// How to pin the OpenMP threads to CPUs.
+  LSDAffinityMode thread_affinity = NO_AFFINITY;
+  /// Print the CPU of each thread and the memory node of each array
+  /// at start up.
+  bool placement_report = false;
+
+  /// Use the kernel instantiations specialised on the model options
+  /// instead of the generic ones (see select_kernels()).
+  bool specialised_kernels = false;
+  /// The option flags, for the generic kernels.
+  LSDRuntimeOptions runtime_options;
+  /// The kernel instantiations picked by select_kernels().
+  typedef void (LSDCatchmentModel::*HydroKernel)();
+  typedef double (LSDCatchmentModel::*ErosionKernel)(double);
+  HydroKernel flow_route_kernel = NULL;
+  HydroKernel depth_update_kernel = NULL;
+  HydroKernel fused_hydro_step_kernel = NULL;
+  HydroKernel erosion_rates_kernel = NULL;
+  ErosionKernel erosion_transfers_kernel = NULL;
+
+  // Throughput counters for the flow_route() and depth_update() kernels
+  double hydro_kernel_seconds = 0.0;
+  long long hydro_cells_processed = 0;
+  // Time spent keeping the wet lists up to date (check_wetted_area)
+  double wet_scan_seconds = 0.0;
+  // Time spent in erode()
+  double erosion_seconds = 0.0;
+  /// Only revisit the cells near the last landslides in
+  /// global_landsliding(), instead of sweeping the whole DEM.
+  bool landslide_worklist = true;
+  /// Do in_channel_landsliding() in parallel, by colour classes.
+  bool coloured_channel_landsliding = false;
+  // Time spent in in_channel_landsliding()
+  double channel_landslide_seconds = 0.0;
+  // Work done by global_landsliding()
+  double landslide_seconds = 0.0;
+  long long landslide_sweeps = 0;
+  long long landslide_cell_visits = 0;
+  /// The next global_landsliding() has to test every cell (the first)
+  bool landslide_seed_all = true;
+  /// The cells whose height changed since the last global_landsliding(),
+  /// see note_height_change(): flagged, and listed per thread.
+  LSDGrid<unsigned char> landslide_changed;
+  std::vector<std::vector<int> > landslide_changed_cells;
+  /// Take each creep() step implicitly, see implicit_hillslope_diffusion().
+  bool implicit_creep = false;
+  /// Days between the creep() steps (0: the interval main() passes in).
+  double creep_interval_days = 0;
+  // Work done by creep()
+  double creep_seconds = 0.0;
+  long long creep_steps = 0;
+  long long creep_cg_iterations = 0;
+  /// What each cell sends each neighbour in a hillslope step, 8 per cell
+  /// (-1 for none), see hillslope_sent().
+  std::vector<double> hillslope_out;
+  /// The cells of each row x that send any material in a hillslope step,
+  /// in y order.
+  std::vector<std::vector<int> > hillslope_senders;
+
+  /// 0: erosion sets the global time step (it grows it and cuts it back to
+  /// the erosion limit). 1: erosion keeps its own step (erosion_step) and
+  /// catches up with the model time on each call, see erode().
+  int erode_timestep_type = 0;
+  /// The time step of erode(), in seconds.
+  double erosion_step = 0;
+  /// The longest step the erosion limit allows, with erode_timestep_type 1.
+  double erosion_step_allowed = 0;
+  /// The number of calls to erode(), and of the steps it took with
+  /// erode_timestep_type 1.
+  long long erosion_calls = 0;
+  long long erosion_substeps = 0;
+  /// The model time (cycle) erode() has caught up to, with
+  /// erode_timestep_type 1.
+  double erosion_cycle = 0;
+  /// The morphological acceleration factor (MORFAC): every second of flow
+  /// changes the landscape as much as this many seconds would. Scales the
+  /// bed changes of erode(), creep() and grow_grass(), see
+  /// morphological_time().
+  double morphological_factor = 1.0;
+  /// The model time (cycle) the morphological time is counted from.
+  double morphological_start = 0;
   int hydro_timestep_type = 0;  // 0 for default
 
   // Bools for writing out files
@@ -0,0 +1,94 @@
+// LSDFlowKernels.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * Vectorised (AVX2 and AVX-512) versions of the LISFLOOD face discharge
+ * update used by LSDCatchmentModel::flow_route().
+ *
+ * A kernel updates the discharge across one face (x or y direction) for a
+ * run of consecutive cells in a row of the model grids. Each cell is paired
+ * with the neighbour across its face: the same column in the row above for
+ * x faces, or the previous column of the same row for y faces. The branches
+ * of the scalar code (the wet test, the Froude limiter, the discharge vs.
+ * depth limiter and the suspended sediment flux) become lane masks and
+ * blends.
+ *
+ * The instruction set is chosen once at start up from the CPUID flags of
+ * the host. If neither AVX2 nor AVX-512 is available, no kernel is
+ * returned and the model keeps using the scalar per-cell code.
+ *
+ * Tolerance: the kernels do the same sums as the scalar code, and both
+ * divide by hflow cubed multiplied out (hflow * hflow * hflow), so the
+ * discharges agree with the scalar code to rounding error; the Boscastle
+ * known good answers are reproduced exactly. Over any run the water
+ * depths and hydrographs must stay within the rtol=1e-3 of the known good
+ * answer tests.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDFlowKernels_H
+#define LSDFlowKernels_H
+
+#include <string>
+
+/// @brief The arrays one face kernel call works on.
+/// @details All pointers are to the first cell of the run; the kernel
+/// touches elements [0, count). The _nb arrays hold the neighbour across
+/// the face of each cell. mannings may be NULL, in which case the uniform
+/// value in LSDFaceParams is used.
+struct LSDFaceSpan
+{
+  const double* elev;
+  const double* depth;
+  const double* susp;
+  const double* elev_nb;
+  const double* depth_nb;
+  const double* susp_nb;
+  const double* mannings;
+  double* q;
+  double* qs;
+  /// Set to hflow for the faces that carried flow, zero elsewhere. The
+  /// caller uses it to update vel_dir.
+  double* hflow_out;
+  int count;
+};
+
+/// @brief The constants of a face kernel call.
+struct LSDFaceParams
+{
+  double gravity;
+  double flow_timestep;
+  double DX;
+  double mannings;
+  double hflow_threshold;
+  double froude_limit;
+  /// Water surface slope across the face when it is fixed (the edge
+  /// cells). Only used if fixed_slope is true.
+  double slope;
+  bool fixed_slope;
+  bool suspended;
+};
+
+/// A face kernel updates q (and qs) for every cell of a span.
+typedef void (*LSDFaceKernel)(const LSDFaceSpan&, const LSDFaceParams&);
+
+namespace LSDFlowKernels
+{
+  void lisflood_face_avx2(const LSDFaceSpan& span, const LSDFaceParams& params);
+  void lisflood_face_avx512(const LSDFaceSpan& span, const LSDFaceParams& params);
+
+  /// @brief Picks a face kernel for this CPU.
+  /// @param requested "auto", "avx512" or "avx2". A request the CPU cannot
+  /// run falls back to the best one it can.
+  /// @param chosen Set to the name of the instruction set picked, or
+  /// "scalar" if there is no vector kernel for this CPU.
+  /// @return The kernel, or NULL for the scalar fallback.
+  LSDFaceKernel select_face_kernel(const std::string& requested,
+                                   std::string& chosen);
+}
+
+#endif
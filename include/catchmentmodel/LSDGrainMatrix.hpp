@@ -25,6 +25,7 @@
 #include <fstream>
 #include <sstream>
 #include "TNT/tnt.h"
+#include "LSDGrainPool.hpp"
 
 #ifndef LSDGrainMatrix_H
 #define LSDGrainMatrix_H
@@ -50,12 +51,13 @@ public:
   */
   /// Create a GrainMatrix object from references to arrays (in LSDCatchmentModel, though needn't be this object)
   LSDGrainMatrix( int imax, int jmax, int NoDataVal, int G_MAX,
+                  int strata_layers,
                   TNT::Array2D<int>& indexes, 
-                  TNT::Array2D<double>& graindatas,
-                  TNT::Array3D<double>& stratadatas)
+                  const LSDGrainPool& graindatas,
+                  const LSDStrataPool& stratadatas)
     : rasterIndex(indexes), grainData(graindatas), strataData(stratadatas)
   {
-    create(imax, jmax, NoDataVal, G_MAX);
+    create(imax, jmax, NoDataVal, G_MAX, strata_layers);
   }
   
   /// Writes the GrainMatrix object to an output text file (Warning: large file!)
@@ -63,18 +65,19 @@ public:
   
 protected:
   TNT::Array2D<int>& rasterIndex;
-  TNT::Array2D<double>& grainData;
-  TNT::Array3D<double>& strataData;
+  const LSDGrainPool& grainData;
+  const LSDStrataPool& strataData;
   
   int NCols;
   int NRows;
   int NoData;
   int GrainFracMax;
+  int StrataLayers;
   
 private:
   //void create();
   //void create(std::string fname, std::string fname_extension);
-  void create(int imax, int jmax, int NoDataVal, int G_MAX);
+  void create(int imax, int jmax, int NoDataVal, int G_MAX, int strata_layers);
   
 };
     
@@ -0,0 +1,278 @@
+// LSDGrainPool.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * Storage for the grain size records of LSDCatchmentModel: the surface
+ * (active layer) grain sizes, grain[slot][n], and the subsurface strata,
+ * strata[slot][z][n]. The index grid maps each cell to its record slot,
+ * or to -9999 if it has none.
+ *
+ * These used to be TNT arrays with a record for every cell of the domain
+ * (divided by memory_limit), about 1 KB a cell whether or not the cell
+ * was ever wet, which runs to gigabytes on a large DEM before the model
+ * has started. Only the cells that erode() or the grain data file give a
+ * record to need one, so the records are now kept in chunks of
+ * RECORDS_PER_CHUNK, allocated as the slots are taken and kept until the
+ * pool is destroyed. The memory used grows with the area the channel has
+ * covered, not with the size of the DEM.
+ *
+ * The directory of chunks is made big enough for the largest number of
+ * records at the start, so it never moves, and reaching a record is one
+ * extra load: grain[slot] is
+ *
+ *   chunks[slot / RECORDS_PER_CHUNK] + (slot % RECORDS_PER_CHUNK) * size
+ *
+ * Slots must be made usable with reserve() before they are used. reserve()
+ * may be called from any thread: new chunks are allocated under a lock,
+ * but once a chunk exists reserving a slot in it only reads the chunk
+ * count. The chunks are allocated with calloc, so they come as fresh zero
+ * pages (see LSDPlacement::use_fresh_pages()) and are placed on the memory
+ * node of the thread that sets up their first records.
+ *
+ * The strata of a record are a stack of layers, top (z = 0) to bottom,
+ * which sort_active() pushes a layer onto as the cell deposits, dropping
+ * the bottom one, and pops as it erodes, adding a new bottom layer. The
+ * layers are kept as a ring, with the position of the top layer stored
+ * after them in the record, so pushing or popping moves the top instead of
+ * copying every layer down or up. strata[slot][z] goes through the ring,
+ * so the layers read (and are written to the grain size file) in the same
+ * order as before.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDGrainPool_H
+#define LSDGrainPool_H
+
+#include <cstdlib>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+
+/// @brief A growable pool of fixed size records of doubles, in chunks.
+/// @details Slots run from 0 to max_records()-1.
+class LSDRecordPool
+{
+public:
+
+  /// Records in each chunk (a power of two).
+  static const int RECORDS_PER_CHUNK = 1024;
+
+  /// Creates an empty pool with no slots.
+  LSDRecordPool() : record_size(0), max_slots(0), n_chunks(0) {}
+
+  /// Creates a pool of up to max_records records of record_size doubles.
+  /// No chunks are allocated yet.
+  LSDRecordPool(int max_records, int record_size_in)
+    : record_size(record_size_in), max_slots(max_records), n_chunks(0),
+      chunks((max_records + RECORDS_PER_CHUNK - 1) / RECORDS_PER_CHUNK, NULL)
+  {}
+
+  LSDRecordPool(LSDRecordPool&& other)
+    : record_size(0), max_slots(0), n_chunks(0)
+  {
+    swap(other);
+  }
+
+  LSDRecordPool& operator=(LSDRecordPool&& other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  ~LSDRecordPool() { release(); }
+
+  /// The record in slot, pool[slot][i] for i < record_size.
+  inline double* operator[](int slot)
+  {
+    return chunks[slot / RECORDS_PER_CHUNK]
+           + static_cast<long>(slot % RECORDS_PER_CHUNK) * record_size;
+  }
+  inline const double* operator[](int slot) const
+  {
+    return chunks[slot / RECORDS_PER_CHUNK]
+           + static_cast<long>(slot % RECORDS_PER_CHUNK) * record_size;
+  }
+
+  /// Makes slots 0..slots-1 usable, allocating (zeroed) chunks for them
+  /// as needed. Safe to call from several threads at once. Stops the
+  /// program if the pool cannot hold that many records.
+  void reserve(int slots)
+  {
+    const int needed = (slots + RECORDS_PER_CHUNK - 1) / RECORDS_PER_CHUNK;
+    if (needed <= n_chunks.load(std::memory_order_acquire)) return;
+
+    #pragma omp critical(LSDRecordPool_reserve)
+    {
+      if (slots > max_slots)
+      {
+        std::cout << "\n FATAL ERROR: more than " << max_slots
+                  << " grain size records are needed. Lower memory_limit."
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      int have = n_chunks.load(std::memory_order_relaxed);
+      for (; have < needed; have++)
+      {
+        void* chunk = std::calloc(static_cast<size_t>(RECORDS_PER_CHUNK) * record_size,
+                                  sizeof(double));
+        if (chunk == NULL)
+        {
+          std::cout << "\n FATAL ERROR: out of memory for the grain size records."
+                    << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        chunks[have] = static_cast<double*>(chunk);
+        // Publish the chunk only once its pointer is in the directory
+        n_chunks.store(have + 1, std::memory_order_release);
+      }
+    }
+  }
+
+  /// The whole record in slot, as record_length() doubles (for strata,
+  /// the ring of layers and its top), to move records between slots.
+  inline double* record(int slot) { return LSDRecordPool::operator[](slot); }
+
+  /// The number of doubles in each record.
+  int record_length() const { return record_size; }
+
+  /// The number of slots the pool can hold.
+  int max_records() const { return max_slots; }
+
+  /// The number of slots currently usable (whole chunks).
+  int reserved() const { return n_chunks.load() * RECORDS_PER_CHUNK; }
+
+  /// Bytes held by the allocated chunks.
+  size_t bytes() const
+  {
+    return static_cast<size_t>(n_chunks.load()) * RECORDS_PER_CHUNK
+           * record_size * sizeof(double);
+  }
+
+protected:
+
+  void swap(LSDRecordPool& other)
+  {
+    std::swap(record_size, other.record_size);
+    std::swap(max_slots, other.max_slots);
+    int mine = n_chunks.load();
+    n_chunks.store(other.n_chunks.load());
+    other.n_chunks.store(mine);
+    chunks.swap(other.chunks);
+  }
+
+  void release()
+  {
+    for (int c = 0; c < n_chunks.load(); c++) std::free(chunks[c]);
+    n_chunks.store(0);
+  }
+
+  int record_size;
+  int max_slots;
+  std::atomic<int> n_chunks;
+  std::vector<double*> chunks;
+
+private:
+
+  // Chunks are owned, so the pool can only be moved
+  LSDRecordPool(const LSDRecordPool&);
+  LSDRecordPool& operator=(const LSDRecordPool&);
+};
+
+/// @brief The surface grain size records, grain[slot][n].
+typedef LSDRecordPool LSDGrainPool;
+
+/// @brief The strata records, strata[slot][z][n]: a ring of layers rows
+/// of width doubles each, then the ring position of the top layer.
+class LSDStrataPool : public LSDRecordPool
+{
+public:
+
+  /// The layers of one record, record[z][n], z = 0 being the top.
+  class Layers
+  {
+  public:
+    Layers(double* first_in, int width_in, int layers_in, int top_in)
+      : first(first_in), width(width_in), layers(layers_in), top(top_in) {}
+    inline double* operator[](int z) const
+    {
+      int ring = top + z;
+      if (ring >= layers) ring -= layers;
+      return first + static_cast<long>(ring) * width;
+    }
+  private:
+    double* first;
+    int width;
+    int layers;
+    int top;
+  };
+
+  LSDStrataPool() : width(0), layers(0) {}
+
+  LSDStrataPool(int max_records, int layers_in, int width_in)
+    : LSDRecordPool(max_records, layers_in * width_in + 1),
+      width(width_in), layers(layers_in)
+  {}
+
+  LSDStrataPool(LSDStrataPool&& other)
+    : LSDRecordPool(std::move(other)), width(other.width), layers(other.layers)
+  {}
+
+  LSDStrataPool& operator=(LSDStrataPool&& other)
+  {
+    LSDRecordPool::operator=(std::move(other));
+    std::swap(width, other.width);
+    std::swap(layers, other.layers);
+    return *this;
+  }
+
+  inline Layers operator[](int slot)
+  {
+    double* record = LSDRecordPool::operator[](slot);
+    return Layers(record, width, layers, top_of(record));
+  }
+  inline const Layers operator[](int slot) const
+  {
+    double* record = const_cast<double*>(LSDRecordPool::operator[](slot));
+    return Layers(record, width, layers, top_of(record));
+  }
+
+  /// Pushes a new top layer, a copy of the old top one, onto the strata
+  /// of slot. The bottom layer is dropped.
+  inline void push_layer(int slot)
+  {
+    double* record = LSDRecordPool::operator[](slot);
+    const int old_top = top_of(record);
+    const int new_top = (old_top == 0) ? layers - 1 : old_top - 1;
+    std::copy(record + static_cast<long>(old_top) * width,
+              record + static_cast<long>(old_top + 1) * width,
+              record + static_cast<long>(new_top) * width);
+    record[layers * width] = new_top;
+  }
+
+  /// Pops the top layer off the strata of slot. Its row becomes the
+  /// bottom layer, for the caller to fill.
+  inline void pop_layer(int slot)
+  {
+    double* record = LSDRecordPool::operator[](slot);
+    const int old_top = top_of(record);
+    record[layers * width] = (old_top + 1 == layers) ? 0 : old_top + 1;
+  }
+
+private:
+
+  inline int top_of(const double* record) const
+  {
+    return static_cast<int>(record[layers * width]);
+  }
+
+  int width;
+  int layers;
+};
+
+#endif
@@ -0,0 +1,273 @@
+// LSDGrid.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * LSDGrid is a flat, aligned 2D grid container used for the hot model
+ * state of the LSDCatchmentModel (elevations, water depths, discharges etc.)
+ *
+ * Unlike TNT::Array2D, which reaches each row through a vector of row
+ * pointers and makes no promise about alignment, an LSDGrid keeps the whole
+ * field in one contiguous buffer. Every row starts on a 64-byte (cache line)
+ * boundary, and the grid carries a ghost-cell halo around the requested
+ * extent so that stencils may read one cell past the array edge safely.
+ *
+ * The grid is indexed exactly like a TNT array, grid[i][j], so it is a
+ * drop-in replacement in the model code. Kernels that want the compiler to
+ * vectorise can instead fetch raw row pointers with row(), and declare them
+ * LSD_RESTRICT.
+ *
+ * Copies are deep (the TNT arrays share their data on copy and assignment).
+ * Use to_TNT() to hand a grid to the LSDRaster or LSDGrainMatrix output
+ * routines.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDGrid_H
+#define LSDGrid_H
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include "TNT/tnt.h"
+
+#if defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER)
+  #define LSD_RESTRICT __restrict__
+#else
+  #define LSD_RESTRICT
+#endif
+
+/// @brief A contiguous, cache-line aligned 2D grid with a ghost cell halo.
+/// @details Valid indices run from -halo to dim1()+halo-1 (rows) and
+/// -halo to dim2()+halo-1 (columns). The halo is filled with the
+/// initial value and is never touched by the model unless a kernel
+/// reads past its own padding.
+template <class T>
+class LSDGrid
+{
+public:
+
+  /// Bytes each row is aligned to.
+  static const int ALIGNMENT = 64;
+
+  /// Creates an empty grid.
+  LSDGrid() : nrows(0), ncols(0), halo_width(0), row_stride(0),
+              buffer(NULL), buffer_size(0), origin(NULL) {}
+
+  /// Creates a grid of nrows x ncols, plus a halo of halo cells on
+  /// every side, with every element (including the halo) set to init_value.
+  LSDGrid(int nrows_in, int ncols_in, const T& init_value = T(),
+          int halo_in = 1)
+    : nrows(0), ncols(0), halo_width(0), row_stride(0),
+      buffer(NULL), buffer_size(0), origin(NULL)
+  {
+    allocate(nrows_in, ncols_in, halo_in);
+    fill(init_value);
+  }
+
+  /// Creates a grid the same size as a TNT array and copies its values in.
+  /// The halo is filled with init_value.
+  explicit LSDGrid(const TNT::Array2D<T>& in, const T& init_value = T(),
+                   int halo_in = 1)
+    : nrows(0), ncols(0), halo_width(0), row_stride(0),
+      buffer(NULL), buffer_size(0), origin(NULL)
+  {
+    allocate(in.dim1(), in.dim2(), halo_in);
+    fill(init_value);
+    inject_TNT(in);
+  }
+
+  /// Deep copy.
+  LSDGrid(const LSDGrid<T>& other)
+    : nrows(0), ncols(0), halo_width(0), row_stride(0),
+      buffer(NULL), buffer_size(0), origin(NULL)
+  {
+    copy_from(other);
+  }
+
+  /// Deep copy.
+  LSDGrid<T>& operator=(const LSDGrid<T>& other)
+  {
+    if (this != &other) copy_from(other);
+    return *this;
+  }
+
+  LSDGrid(LSDGrid<T>&& other)
+    : nrows(0), ncols(0), halo_width(0), row_stride(0),
+      buffer(NULL), buffer_size(0), origin(NULL)
+  {
+    swap(other);
+  }
+
+  LSDGrid<T>& operator=(LSDGrid<T>&& other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  ~LSDGrid() { release(); }
+
+  /// Creates a grid the same shape as other without writing to it, so none
+  /// of its memory pages are placed on a NUMA node yet. Fill it with
+  /// copy_rows() or copy_columns() from the threads that will use each part.
+  static LSDGrid<T> unfilled_like(const LSDGrid<T>& other)
+  {
+    LSDGrid<T> grid;
+    grid.allocate(other.nrows, other.ncols, other.halo_width);
+    return grid;
+  }
+
+  /// Row access, grid[i][j], as for TNT::Array2D.
+  inline T* operator[](int i) { return origin + static_cast<long>(i) * row_stride; }
+  inline const T* operator[](int i) const { return origin + static_cast<long>(i) * row_stride; }
+
+  /// Raw (aligned) pointer to the first element of row i, for kernels.
+  inline T* row(int i) { return origin + static_cast<long>(i) * row_stride; }
+  inline const T* row(int i) const { return origin + static_cast<long>(i) * row_stride; }
+
+  int dim1() const { return nrows; }
+  int dim2() const { return ncols; }
+  int halo() const { return halo_width; }
+
+  /// Number of elements between the start of consecutive rows
+  /// (always a multiple of the cache line).
+  long stride() const { return row_stride; }
+
+  /// Total bytes held by the grid, including halo and padding.
+  size_t bytes() const { return buffer_size * sizeof(T); }
+
+  /// Pointer to the start of the whole allocation (halo included).
+  T* data() { return buffer; }
+  const T* data() const { return buffer; }
+
+  /// Sets every element, halo included.
+  void fill(const T& value)
+  {
+    std::fill(buffer, buffer + buffer_size, value);
+  }
+
+  /// Copies the grid (without its halo) into a TNT array, for the
+  /// LSDRaster and LSDGrainMatrix output routines. U is the element type
+  /// of the copy, e.g. to_TNT<double>() to write out a float grid.
+  template <class U = T>
+  TNT::Array2D<U> to_TNT() const
+  {
+    TNT::Array2D<U> out(nrows, ncols);
+    for (int i = 0; i < nrows; i++)
+    {
+      std::copy(row(i), row(i) + ncols, out[i]);
+    }
+    return out;
+  }
+
+  /// Copies rows first..last, padding included, from a grid of the same
+  /// shape. The outermost halo rows are -halo() and dim1()+halo()-1.
+  void copy_rows(const LSDGrid<T>& from, int first, int last)
+  {
+    if (last < first) return;
+    const long begin = (first + halo_width) * row_stride;
+    const long end = (last + 1 + halo_width) * row_stride;
+    std::copy(from.buffer + begin, from.buffer + end, buffer + begin);
+  }
+
+  /// Copies columns first..last of every row, halo rows included, from a
+  /// grid of the same shape. A range from the first halo column (-halo())
+  /// or to the last (dim2()+halo()-1) takes the row padding with it.
+  void copy_columns(const LSDGrid<T>& from, int first, int last)
+  {
+    if (last < first) return;
+    const long lead = (origin - buffer) - halo_width * row_stride;
+    for (int r = 0; r < nrows + 2 * halo_width; r++)
+    {
+      const long row_start = r * row_stride;
+      const long begin = (first <= -halo_width) ? row_start :
+                         row_start + lead + first;
+      const long end = (last >= ncols - 1 + halo_width) ?
+                       row_start + row_stride : row_start + lead + last + 1;
+      std::copy(from.buffer + begin, from.buffer + end, buffer + begin);
+    }
+  }
+
+  /// Copies a TNT array into the grid, offset by (row_offset, col_offset).
+  /// Used to load the unpadded raster data into the padded model domain.
+  void inject_TNT(const TNT::Array2D<T>& in, int row_offset = 0,
+                  int col_offset = 0)
+  {
+    for (int i = 0; i < in.dim1(); i++)
+    {
+      for (int j = 0; j < in.dim2(); j++)
+      {
+        (*this)[i + row_offset][j + col_offset] = in[i][j];
+      }
+    }
+  }
+
+private:
+
+  int nrows;
+  int ncols;
+  int halo_width;
+  long row_stride;
+  T* buffer;
+  size_t buffer_size;
+  T* origin;
+
+  void allocate(int nrows_in, int ncols_in, int halo_in)
+  {
+    release();
+    nrows = nrows_in;
+    ncols = ncols_in;
+    halo_width = halo_in;
+
+    // Pad the leading halo out to a whole cache line, so that column 0 of
+    // every row is aligned, then round the row length up to whole lines.
+    const long per_line = (ALIGNMENT >= static_cast<int>(sizeof(T))) ?
+                          ALIGNMENT / static_cast<long>(sizeof(T)) : 1;
+    const long lead = ((halo_width + per_line - 1) / per_line) * per_line;
+    row_stride = ((lead + ncols + halo_width + per_line - 1) / per_line) * per_line;
+
+    buffer_size = static_cast<size_t>(row_stride) * (nrows + 2 * halo_width);
+    if (buffer_size == 0) return;
+
+    void* mem = NULL;
+    if (posix_memalign(&mem, ALIGNMENT, buffer_size * sizeof(T)) != 0)
+    {
+      throw std::bad_alloc();
+    }
+    buffer = static_cast<T*>(mem);
+    origin = buffer + halo_width * row_stride + lead;
+  }
+
+  void release()
+  {
+    std::free(buffer);
+    buffer = NULL;
+    origin = NULL;
+    buffer_size = 0;
+  }
+
+  void copy_from(const LSDGrid<T>& other)
+  {
+    allocate(other.nrows, other.ncols, other.halo_width);
+    std::copy(other.buffer, other.buffer + other.buffer_size, buffer);
+  }
+
+  void swap(LSDGrid<T>& other)
+  {
+    std::swap(nrows, other.nrows);
+    std::swap(ncols, other.ncols);
+    std::swap(halo_width, other.halo_width);
+    std::swap(row_stride, other.row_stride);
+    std::swap(buffer, other.buffer);
+    std::swap(buffer_size, other.buffer_size);
+    std::swap(origin, other.origin);
+  }
+};
+
+#endif
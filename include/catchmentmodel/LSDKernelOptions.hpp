@@ -0,0 +1,95 @@
+// LSDKernelOptions.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * Option policies for the templated hydro and erosion kernels of
+ * LSDCatchmentModel (flow_route(), depth_update(), fused_hydro_step()
+ * and the erosion rate pass of erode()).
+ *
+ * The kernels are written once, as templates over an Options class, and
+ * ask it about the model options instead of reading the flags directly:
+ *
+ *   if (opts.suspended) { ... }
+ *
+ * LSDRuntimeOptions holds the flags as ordinary members, so the test is
+ * made for every cell, as in the untemplated code. LSDFlowOptions carries
+ * them as compile time constants instead, so the branches on them fold
+ * away and each combination of options gets its own copy of the kernel.
+ * LSDErosionOptions fixes only the sediment transport law (and the
+ * number of fractions, below), which set the work in the inner loops. The
+ * other erosion options are branches that go the same way for every cell,
+ * and a copy of the kernel for every combination of them made the model
+ * slow to compile and twice the size for no measurable gain.
+ * LSDCatchmentModel::select_kernels() picks the instantiations matching
+ * the parameter file once, at start up.
+ *
+ * The erosion kernel also loops over the grain size fractions of each
+ * cell. Their number is a member, fractions, which LSDErosionOptions fixes
+ * at compile time for the common counts (1, 3, 5 and 9), so those loops
+ * have a constant trip count. Other counts use the run time value.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDKernelOptions_H
+#define LSDKernelOptions_H
+
+/// @brief The model options the kernels branch on, read at run time.
+struct LSDRuntimeOptions
+{
+  bool spatial_mannings;
+  bool suspended;
+  bool wilcock;
+  bool einstein;
+  bool vegetation;
+  bool bedrock;
+  /// The number of grain size fractions (G_MAX - 1)
+  int fractions;
+};
+
+/// @brief Flow routing and depth update options fixed at compile time.
+template <bool SpatialMannings, bool Suspended>
+struct LSDFlowOptions
+{
+  static const bool spatial_mannings = SpatialMannings;
+  static const bool suspended = Suspended;
+
+  /// The run time values are already known, so they are ignored.
+  explicit LSDFlowOptions(const LSDRuntimeOptions&) {}
+};
+
+/// The sediment transport laws of erode().
+enum LSDTransportLaw
+{
+  NO_TRANSPORT_LAW,
+  WILCOCK_LAW,
+  EINSTEIN_LAW
+};
+
+/// @brief Erosion options, with the transport law fixed at compile time.
+/// @details Only the transport law and the number of grain size fractions
+/// are template parameters. The other options are copied from the run time
+/// options and tested as in the generic kernel.
+/// Fractions is the number of grain size fractions, or 0 to take it from
+/// the run time options.
+template <int Law, int Fractions>
+struct LSDErosionOptions
+{
+  static const bool wilcock = (Law == WILCOCK_LAW);
+  static const bool einstein = (Law == EINSTEIN_LAW);
+  const bool spatial_mannings;
+  const bool suspended;
+  const bool vegetation;
+  const bool bedrock;
+  const int fractions;
+
+  explicit LSDErosionOptions(const LSDRuntimeOptions& opts)
+    : spatial_mannings(opts.spatial_mannings), suspended(opts.suspended),
+      vegetation(opts.vegetation), bedrock(opts.bedrock),
+      fractions(Fractions > 0 ? Fractions : opts.fractions) {}
+};
+
+#endif
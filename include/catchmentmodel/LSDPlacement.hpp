@@ -0,0 +1,83 @@
+// LSDPlacement.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * Thread pinning and NUMA page placement queries for LSDCatchmentModel.
+ *
+ * On a machine with more than one memory node (socket), a page of memory
+ * is placed on the node of the thread that first writes to it. The model
+ * arrays used to be allocated and zeroed by the master thread alone, so
+ * they all ended up on its node, and the threads on the other sockets
+ * read them remotely. LSDCatchmentModel::place_arrays() copies the large
+ * fields into new buffers from inside the kernel thread team, each thread
+ * writing the stripe it will later work on. That only helps if the
+ * threads stay on their CPUs, so pin_threads() can pin each OpenMP thread
+ * to one CPU, and the placement report shows where the pages and threads
+ * actually ended up.
+ *
+ * Everything here uses Linux system calls directly (sched_setaffinity,
+ * getcpu, move_pages) so there is no dependency on libnuma. On other
+ * systems pinning does nothing and the nodes are reported as unknown.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDPlacement_H
+#define LSDPlacement_H
+
+#include <string>
+#include <vector>
+
+/// @brief How pin_threads() assigns the OpenMP threads to CPUs.
+enum LSDAffinityMode
+{
+  NO_AFFINITY,     ///< Leave the threads to the operating system
+  CLOSE_AFFINITY,  ///< Thread t on the t-th allowed CPU
+  SPREAD_AFFINITY  ///< Threads spaced out evenly over the allowed CPUs
+};
+
+namespace LSDPlacement
+{
+
+/// Parses an affinity name ("none", "close" or "spread").
+/// @return false if the name is not recognised.
+bool parse_affinity(const std::string& name, LSDAffinityMode& mode_out);
+
+std::string affinity_name(LSDAffinityMode mode);
+
+/// Pins every thread of the OpenMP team to one of the CPUs the process
+/// is allowed to run on. Threads are only pinned if the team is no bigger
+/// than the number of those CPUs.
+/// @return false if the threads could not be pinned.
+bool pin_threads(LSDAffinityMode mode);
+
+/// Makes every large allocation from here on come straight from the
+/// operating system, as fresh pages that no thread has touched yet. (By
+/// default glibc recycles freed heap memory for them, which the master
+/// thread may already have placed.)
+void use_fresh_pages();
+
+/// The CPU and memory node the calling thread is running on, -1 if
+/// unknown.
+void current_cpu(int& cpu, int& node);
+
+/// The size of a memory page in bytes (4096 if it cannot be found).
+long page_size();
+
+/// Counts the pages of [start, start + bytes) on each memory node.
+/// pages[n] is the number on node n; pages that have not been touched
+/// yet, or whose node cannot be found, are counted in unplaced.
+/// @return false if the nodes cannot be queried on this system.
+bool page_nodes(const void* start, size_t bytes,
+                std::vector<long>& pages, long& unplaced);
+
+/// Formats page_nodes() for the placement report, e.g.
+/// "node 0: 50.0%, node 1: 50.0%".
+std::string describe_placement(const void* start, size_t bytes);
+
+}
+
+#endif
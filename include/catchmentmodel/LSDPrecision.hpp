@@ -0,0 +1,33 @@
+// LSDPrecision.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * The floating point type the hydrodynamic state is stored in.
+ *
+ * By default everything is double. Building with -DLSD_SINGLE_PRECISION
+ * (make PRECISION=single) stores the water depths, discharges, velocities,
+ * shear stresses and the runoff grids as float instead. The arithmetic on
+ * them is still done in double (the values are promoted when they are
+ * read), and the elevations, sediment and the mass balance accumulators
+ * (waterinput, waterOut, Qw_newvol, globalsediq...) stay double, so only
+ * the rounding of the stored state changes. Halving the size of these
+ * fields halves the memory traffic of the flow routing.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDPrecision_H
+#define LSDPrecision_H
+
+#ifdef LSD_SINGLE_PRECISION
+  typedef float hydro_real;
+  #define HYDRO_PRECISION_NAME "single (float)"
+#else
+  typedef double hydro_real;
+  #define HYDRO_PRECISION_NAME "double"
+#endif
+
+#endif
@@ -21,6 +21,8 @@
 #define LSDRAINFALLRUNOFF_H
 
 #include "TNT/tnt.h"
+#include "LSDGrid.hpp"
+#include "LSDPrecision.hpp"
 #include "topotools/LSDStatsTools.hpp" // This contains some spline interpolation functions already
 
 /// @brief rainGrid is a class used to store and manipulate rainfall data.
@@ -62,7 +64,7 @@ public:
   /// extra third variable which would be terrain in most cases (see
   /// Tait et al 2006, for example)
   void interpolateRainfall_RectTrivariateSpline(rainGrid& raingrid,
-                                                const TNT::Array2D<double>& elevation);
+                                                const LSDGrid<double>& elevation);
   
   /// Takes the rainfall data for a current timestep and
   /// reshapes it into a 2D array. 
@@ -91,7 +93,7 @@ protected:
 
   /// For a single instance of a 2D rainfall grid, matching the dimensions of the
   /// model domain.
-  TNT::Array2D<double> rainfallgrid2D;
+  TNT::Array2D<hydro_real> rainfallgrid2D;
   /// Experimental - stores grids of rainfall data for every rainfall timestep:
   /// Warning - this could be a massive object!
   TNT::Array3D<double> rainfallgrid3D;
@@ -135,7 +137,7 @@ public:
   runoffGrid(int current_rainfall_timestep, int imax, int jmax,
                      int rain_factor, double M,
                      const rainGrid& current_rainGrid,
-                     const TNT::Array2D<double>& elevations)
+                     const LSDGrid<double>& elevations)
   {
     create(current_rainfall_timestep, imax, jmax,
            rain_factor, M,
@@ -152,7 +154,7 @@ public:
   /// @params Takes a ref to a rainGrid object and the elevations array from LSDCatchmentModel
   void calculate_runoff(int rain_factor, double M, int jmax, int imax, 
                         const rainGrid &current_rainGrid, 
-                        const TNT::Array2D<double>& elevations);
+                        const LSDGrid<double>& elevations);
   
   void write_runoffGrid_to_raster_file(double xmin,
                                        double ymin,
@@ -172,13 +174,13 @@ public:
   void set_j_mean(int m, int n, double cell_j_mean) { j_mean_array[m][n] = cell_j_mean; }
 
 protected:
-  TNT::Array2D<double> j_array, jo_array, j_mean_array, old_j_mean_array, new_j_mean_array;
+  TNT::Array2D<hydro_real> j_array, jo_array, j_mean_array, old_j_mean_array, new_j_mean_array;
 
 private:
   void create(int imax, int jmax);
   void create(int current_rainfall_timestep, int imax, int jmax,
          int rain_factor, double M,
-         const rainGrid& current_rainGrid, const TNT::Array2D<double>& elevations);
+         const rainGrid& current_rainGrid, const LSDGrid<double>& elevations);
 };
 
 
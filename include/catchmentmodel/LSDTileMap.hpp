@@ -0,0 +1,195 @@
+// LSDTileMap.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * LSDTileMap splits the model domain (cells 1..imax by 1..jmax) into
+ * fixed size square tiles and keeps a little summary for each one:
+ *
+ *  - valid: the tile has at least one cell with data (elev > -9999)
+ *  - wet: the tile may hold water, i.e. it has a cell on the wet lists or
+ *    a cell that has been given water since the wet lists were last built
+ *  - max_depth: the deepest water in the tile when the wet lists were
+ *    last built
+ *
+ * Loops over the whole grid use these to skip tiles where nothing can
+ * happen. DEMs are usually rectangles clipped around an irregular
+ * catchment, so a large part of the grid can be no data.
+ *
+ * So that loops skipping tiles still visit the remaining cells in the same
+ * order as a plain row by row sweep (and so give bitwise identical sums),
+ * the valid tiles of each tile row are handed out as column spans: a loop
+ * walks its rows as before and, within a row, only the columns inside the
+ * spans.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDTileMap_H
+#define LSDTileMap_H
+
+#include <vector>
+#include <algorithm>
+
+/// @brief A run of consecutive columns, first to last inclusive.
+struct LSDColumnSpan
+{
+  int first;
+  int last;
+};
+
+/// @brief Tiling of the model domain with per-tile summary flags.
+class LSDTileMap
+{
+public:
+
+  /// Default tile edge length, in cells.
+  static const int DEFAULT_TILE_SIZE = 64;
+
+  /// Creates an empty tile map.
+  LSDTileMap() : imax(0), jmax(0), size(1), ntx(0), nty(0) {}
+
+  /// Creates a tile map over cells 1..imax_in by 1..jmax_in. Every tile
+  /// starts out valid and wet, so nothing is skipped until find_valid()
+  /// and the wet flags have been filled in. A tile_size of zero or less
+  /// gives a single tile covering the whole domain.
+  LSDTileMap(int imax_in, int jmax_in, int tile_size)
+    : imax(imax_in), jmax(jmax_in)
+  {
+    size = (tile_size > 0) ? tile_size : std::max(std::max(imax, jmax), 1);
+    ntx = (imax + size - 1) / size;
+    nty = (jmax + size - 1) / size;
+    valid = std::vector<unsigned char> (ntx * nty, 1);
+    wet = std::vector<unsigned char> (ntx * nty, 1);
+    max_depth = std::vector<double> (ntx * nty, 0.0);
+    build_spans();
+  }
+
+  int tile_size() const { return size; }
+  int tiles_x() const { return ntx; }
+  int tiles_y() const { return nty; }
+
+  /// The tile row of cell row x, and tile column of cell column y.
+  int tile_row(int x) const { return (x - 1) / size; }
+  int tile_col(int y) const { return (y - 1) / size; }
+
+  /// The cell rows of tile row tx (and columns of tile column ty).
+  int first_row(int tx) const { return 1 + tx * size; }
+  int last_row(int tx) const { return std::min((tx + 1) * size, imax); }
+  int first_col(int ty) const { return 1 + ty * size; }
+  int last_col(int ty) const { return std::min((ty + 1) * size, jmax); }
+
+  bool is_valid(int tx, int ty) const { return valid[tx * nty + ty] != 0; }
+  bool is_wet(int tx, int ty) const { return wet[tx * nty + ty] != 0; }
+  double get_max_depth(int tx, int ty) const { return max_depth[tx * nty + ty]; }
+
+  /// True if the tile holding cell (x, y) may hold water.
+  bool wet_at(int x, int y) const
+  {
+    return wet[tile_row(x) * nty + tile_col(y)] != 0;
+  }
+
+  /// The columns of row x that lie in valid tiles, in increasing order.
+  /// Neighbouring valid tiles are merged into one span.
+  const std::vector<LSDColumnSpan>& valid_spans(int x) const
+  {
+    return valid_row_spans[tile_row(x)];
+  }
+
+  /// Marks the tiles holding at least one cell with elevation above
+  /// nodata as valid. Cells do not change between data and no data during
+  /// a run, so this only needs calling once the DEM is loaded.
+  template <class Grid>
+  void find_valid(const Grid& elev, double nodata = -9999)
+  {
+    for (int tx = 0; tx < ntx; tx++)
+    {
+      for (int ty = 0; ty < nty; ty++)
+      {
+        unsigned char any = 0;
+        for (int x = first_row(tx); x <= last_row(tx) && !any; x++)
+        {
+          for (int y = first_col(ty); y <= last_col(ty); y++)
+          {
+            if (elev[x][y] > nodata)
+            {
+              any = 1;
+              break;
+            }
+          }
+        }
+        valid[tx * nty + ty] = any;
+      }
+    }
+    build_spans();
+  }
+
+  /// Clears the wet flags and depths, ready for note_depth() calls.
+  void clear_wet()
+  {
+    std::fill(wet.begin(), wet.end(), 0);
+    std::fill(max_depth.begin(), max_depth.end(), 0.0);
+  }
+
+  /// Marks the tile of cell (x, y) as possibly wet.
+  void mark_wet(int x, int y)
+  {
+    wet[tile_row(x) * nty + tile_col(y)] = 1;
+  }
+
+  /// Marks the tile of cell (x, y) as possibly wet and raises its max
+  /// depth to depth. Safe to call in parallel as long as each thread works
+  /// on its own tiles.
+  void note_depth(int x, int y, double depth)
+  {
+    int t = tile_row(x) * nty + tile_col(y);
+    wet[t] = 1;
+    if (depth > max_depth[t]) max_depth[t] = depth;
+  }
+
+  int count_valid() const
+  {
+    return static_cast<int>(std::count(valid.begin(), valid.end(), 1));
+  }
+
+  int count_wet() const
+  {
+    return static_cast<int>(std::count(wet.begin(), wet.end(), 1));
+  }
+
+private:
+
+  void build_spans()
+  {
+    valid_row_spans = std::vector< std::vector<LSDColumnSpan> > (ntx);
+    for (int tx = 0; tx < ntx; tx++)
+    {
+      for (int ty = 0; ty < nty; ty++)
+      {
+        if (!is_valid(tx, ty)) continue;
+        std::vector<LSDColumnSpan>& spans = valid_row_spans[tx];
+        if (!spans.empty() && spans.back().last + 1 == first_col(ty))
+        {
+          spans.back().last = last_col(ty);
+        }
+        else
+        {
+          LSDColumnSpan span = { first_col(ty), last_col(ty) };
+          spans.push_back(span);
+        }
+      }
+    }
+  }
+
+  int imax, jmax;
+  int size;
+  int ntx, nty;
+  std::vector<unsigned char> valid;
+  std::vector<unsigned char> wet;
+  std::vector<double> max_depth;
+  std::vector< std::vector<LSDColumnSpan> > valid_row_spans;
+};
+
+#endif
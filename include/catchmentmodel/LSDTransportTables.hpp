@@ -0,0 +1,236 @@
+// LSDTransportTables.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * Interpolation tables for the sediment transport functions of the erosion
+ * kernel (LSDCatchmentModel::erosion_rates()).
+ *
+ * The Wilcock and Crowe law evaluates, for every wet cell and every grain
+ * size fraction, the hiding function (Di/D50)^(0.67 / (1 + exp(1.5 - Di/D50))),
+ * and the transport function W* of tau / tau_ri, a power of 7.5 or 4.5.
+ * That is half a dozen exp, log and pow calls per fraction, which is most
+ * of the time spent in erode(). Both only depend on one number, so with
+ * transport_table_tolerance set they are read from tables instead:
+ *
+ *  - the log of the hiding function, over ln(Di) - ln(D50), and
+ *  - W*, over ln(tau / tau_ri), in two tables split where the law
+ *    changes form (tau / tau_ri = 1.35; the two forms do not quite meet
+ *    there, so one table across it could not get within the tolerance),
+ *
+ * plus the reference stress factor 0.021 + 0.015 exp(-20 Fs) over the
+ * sand fraction Fs, once per cell. The logs of the grain sizes are
+ * constants, so the only transcendental calls left are a few logs per
+ * cell.
+ *
+ * LSDWilcockTables holds the tables. An LSDFunctionTable samples a
+ * function at evenly spaced points and interpolates linearly between
+ * them. It doubles the number of points until the interpolation is
+ * within the tolerance everywhere it checks (relative to the function
+ * value, or absolute for the log tables, which is relative for the
+ * function itself). Arguments outside the range of a table are left to
+ * the exact function.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDTransportTables_H
+#define LSDTransportTables_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+/// @brief A function tabulated at evenly spaced points over [lo, hi],
+/// with linear interpolation between them.
+class LSDFunctionTable
+{
+public:
+
+  /// The most intervals build() will use.
+  static const int MAX_INTERVALS = 1 << 20;
+
+  LSDFunctionTable() : lo(0.0), hi(0.0), inv_step(0.0), error(0.0) {}
+
+  /// Tabulates f over [lo_in, hi_in] with as many intervals as it takes
+  /// (a power of two) for the interpolation error to be at most tolerance:
+  /// relative to |f| if relative, otherwise absolute.
+  /// @return false if MAX_INTERVALS were not enough (the table is still
+  /// built, see max_error()).
+  template <class F>
+  bool build(F f, double lo_in, double hi_in, double tolerance, bool relative)
+  {
+    lo = lo_in;
+    hi = hi_in;
+    for (int intervals = 64; ; intervals *= 2)
+    {
+      sample(f, intervals);
+      error = 0.0;
+      for (int i = 0; i < intervals; i++)
+      {
+        // Check between the points, where linear interpolation is worst
+        for (int k = 1; k <= 3; k++)
+        {
+          const double x = lo + (i + 0.25 * k) / inv_step;
+          const double exact = f(x);
+          double e = std::abs((*this)(x) - exact);
+          if (relative) e = (exact != 0.0) ? e / std::abs(exact) : e;
+          error = std::max(error, e);
+        }
+      }
+      if (error <= tolerance) return true;
+      if (intervals >= MAX_INTERVALS) return false;
+    }
+  }
+
+  /// Whether x is inside the table.
+  inline bool covers(double x) const { return x >= lo && x < hi; }
+
+  /// The interpolated value at x, which must be covered.
+  inline double operator()(double x) const
+  {
+    const double s = (x - lo) * inv_step;
+    // s can round up to the last point for x just below hi
+    const int i = std::min(static_cast<int>(s), points() - 2);
+    const double w = s - i;
+    return values[i] + w * (values[i + 1] - values[i]);
+  }
+
+  /// The largest interpolation error build() found.
+  double max_error() const { return error; }
+
+  /// The number of points in the table.
+  int points() const { return static_cast<int>(values.size()); }
+
+private:
+
+  template <class F>
+  void sample(F f, int intervals)
+  {
+    inv_step = intervals / (hi - lo);
+    values.resize(intervals + 1);
+    for (int i = 0; i <= intervals; i++) values[i] = f(lo + i / inv_step);
+  }
+
+  double lo;
+  double hi;
+  double inv_step;
+  double error;
+  std::vector<double> values;
+};
+
+/// The Wilcock and Crowe reference stress factor,
+/// tau_rm / (rho g D50) = 0.021 + 0.015 exp(-20 Fs).
+inline double wilcock_reference_factor(double Fs)
+{
+  return 0.021 + (0.015 * std::exp(-20 * Fs));
+}
+
+/// The log of the Wilcock and Crowe hiding function, tau_ri / tau_rm =
+/// (Di/D50)^(0.67 / (1 + exp(1.5 - Di/D50))), of log_ratio = ln(Di/D50).
+inline double wilcock_log_hiding(double log_ratio)
+{
+  const double ratio = std::exp(log_ratio);
+  return (0.67 / (1 + std::exp(1.5 - ratio))) * log_ratio;
+}
+
+/// The tau / tau_ri at which the Wilcock and Crowe transport function
+/// changes form.
+const double WILCOCK_PHI_BREAK = 1.35;
+
+/// The Wilcock and Crowe transport function W* of phi = tau / tau_ri.
+inline double wilcock_transport(double phi)
+{
+  if (phi < WILCOCK_PHI_BREAK) return 0.002 * std::pow(phi, 7.5);
+  return 14 * std::pow(1 - (0.894 / std::sqrt(phi)), 4.5);
+}
+
+/// W* of ln(tau / tau_ri).
+inline double wilcock_log_transport(double log_phi)
+{
+  return wilcock_transport(std::exp(log_phi));
+}
+
+/// The two forms of W* of ln(tau / tau_ri), each over the whole line (so
+/// the table of each form can include the break).
+inline double wilcock_log_transport_low(double log_phi)
+{
+  return 0.002 * std::exp(7.5 * log_phi);
+}
+inline double wilcock_log_transport_high(double log_phi)
+{
+  return 14 * std::pow(1 - (0.894 * std::exp(-0.5 * log_phi)), 4.5);
+}
+
+/// @brief The tabulated Wilcock and Crowe functions. Arguments outside
+/// the tables are worked out exactly.
+class LSDWilcockTables
+{
+public:
+
+  /// Builds the tables for grain sizes spanning size_spread = ln(largest)
+  /// - ln(smallest).
+  /// @return false if a table could not get within the tolerance.
+  bool build(double size_spread, double tolerance)
+  {
+    // ln(Di/D50) stays within the spread of the grain sizes (D50 is
+    // clamped to the smallest one), and W* is negligible below
+    // ln(tau/tau_ri) = -20
+    const double spread = size_spread + 0.1;
+    const double log_break = std::log(WILCOCK_PHI_BREAK);
+    bool built = reference.build(wilcock_reference_factor, 0.0, 1.001,
+                                 tolerance, true);
+    built &= hiding.build(wilcock_log_hiding, -spread, spread, tolerance, false);
+    built &= transport_low.build(wilcock_log_transport_low, -20.0, log_break,
+                                 tolerance, true);
+    built &= transport_high.build(wilcock_log_transport_high, log_break, 10.0,
+                                  tolerance, true);
+    return built;
+  }
+
+  /// 0.021 + 0.015 exp(-20 Fs)
+  inline double reference_factor(double Fs) const
+  {
+    return reference.covers(Fs) ? reference(Fs) : wilcock_reference_factor(Fs);
+  }
+
+  /// ln of the hiding function of ln(Di/D50)
+  inline double log_hiding(double log_ratio) const
+  {
+    return hiding.covers(log_ratio) ? hiding(log_ratio)
+                                    : wilcock_log_hiding(log_ratio);
+  }
+
+  /// W* of ln(tau / tau_ri)
+  inline double transport(double log_phi) const
+  {
+    if (transport_low.covers(log_phi)) return transport_low(log_phi);
+    if (transport_high.covers(log_phi)) return transport_high(log_phi);
+    return wilcock_log_transport(log_phi);
+  }
+
+  /// The total number of points in the tables.
+  int points() const
+  {
+    return reference.points() + hiding.points() + transport_low.points()
+           + transport_high.points();
+  }
+
+  /// The largest interpolation error of any of the tables.
+  double max_error() const
+  {
+    return std::max(std::max(reference.max_error(), hiding.max_error()),
+                    std::max(transport_low.max_error(),
+                             transport_high.max_error()));
+  }
+
+private:
+  LSDFunctionTable reference;
+  LSDFunctionTable hiding;
+  LSDFunctionTable transport_low;
+  LSDFunctionTable transport_high;
+};
+
+#endif
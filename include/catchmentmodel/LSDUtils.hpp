@@ -10,6 +10,7 @@
 #include <fstream>
 #include <ostream>
 #include <string>
+#include <vector>
 
 namespace LSDUtils
 {
@@ -35,6 +36,10 @@ namespace LSDUtils
   // These get introduced if you use the DOS format in your parameter file
   std::string RemoveControlCharactersFromEndOfString(std::string toRemove);
 
+  // Reads a comma separated list of numbers from a parameter value
+  // (parameter values cannot contain spaces), e.g. "0.001,0.002,0.004"
+  std::vector<double> parse_number_list(const std::string& value);
+
   // Duplicated below -pick one to remove!
   inline bool file_check(std::string name)
   {
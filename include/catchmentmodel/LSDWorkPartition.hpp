@@ -0,0 +1,181 @@
+// LSDWorkPartition.hpp
+// HEADER FILE
+
+/*
+ * SUMMARY
+ *
+ * LSDWorkPartition splits the lines (columns or rows) 1..n of the model
+ * domain into chunks of consecutive lines for the OpenMP loops of the
+ * hydro and erosion kernels. The loops hand the chunks out to the threads
+ * one at a time:
+ *
+ *   #pragma omp for schedule(runtime)
+ *   for (int c = 0; c < work.chunks(); c++)
+ *     for (int y = work.first(c); y <= work.last(c); y++)
+ *
+ * The runtime schedule is set to match the partition (see
+ * run_schedule()): static round robin for the static and weighted
+ * partitions, so thread t always gets chunk t, and dynamic for the dynamic
+ * one.
+ *
+ * The work in a line is the number of wet cells on it, which is very
+ * uneven: a channel column can hold thousands and a hillslope column
+ * none. Splitting the lines evenly (as schedule(static) does) leaves most
+ * threads idle while the one with the channel finishes. So the partition
+ * can be built in three ways:
+ *
+ *  - static: one chunk per thread, each with the same number of lines.
+ *    The same as the plain static schedule.
+ *  - weighted: one chunk per thread, each with about the same number of
+ *    wet cells. Rebuilt every time the wet lists are.
+ *  - dynamic: CHUNKS_PER_THREAD chunks per thread of about the same
+ *    number of wet cells, which the threads take from a shared queue as
+ *    they finish their last one. This evens out what the wet cell count
+ *    misses (dry cells are cheaper than wet ones, erosion only runs on
+ *    some wet cells...) at the cost of a little more scheduling.
+ *
+ * Each line counts as one cell more than it has wet cells, for the cost
+ * of visiting it at all.
+ *
+ * Released under the GNU v2 Public License
+ *
+ */
+
+#ifndef LSDWorkPartition_H
+#define LSDWorkPartition_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+/// @brief How an LSDWorkPartition splits the lines between the threads.
+enum LSDScheduleMode
+{
+  STATIC_SCHEDULE,
+  WEIGHTED_SCHEDULE,
+  DYNAMIC_SCHEDULE
+};
+
+/// @brief Chunks of consecutive domain lines, balanced by wet cell count.
+class LSDWorkPartition
+{
+public:
+
+  /// Chunks per thread in the dynamic schedule.
+  static const int CHUNKS_PER_THREAD = 8;
+
+  /// Creates an empty partition (no chunks).
+  LSDWorkPartition() : mode(STATIC_SCHEDULE), n_lines(0) {}
+
+  /// Creates a static partition of lines 1..n for the given number of
+  /// threads. Call rebuild() to balance it by wet cell count.
+  LSDWorkPartition(LSDScheduleMode mode_in, int n, int threads)
+    : mode(mode_in), n_lines(n)
+  {
+    split_evenly(threads);
+  }
+
+  LSDScheduleMode get_mode() const { return mode; }
+  int chunks() const { return static_cast<int>(firsts.size()); }
+  int first(int c) const { return firsts[c]; }
+  int last(int c) const { return lasts[c]; }
+
+  /// Rebuilds the chunks from the wet cell count of each line,
+  /// wet_cells[1..n]. Does nothing for the static schedule, which does
+  /// not depend on where the water is.
+  void rebuild(const std::vector<int>& wet_cells, int threads)
+  {
+    if (mode == STATIC_SCHEDULE)
+    {
+      if (chunks() != std::max(threads, 1)) split_evenly(threads);
+      return;
+    }
+    int n_chunks = std::max(threads, 1);
+    if (mode == DYNAMIC_SCHEDULE) n_chunks *= CHUNKS_PER_THREAD;
+    n_chunks = std::min(n_chunks, std::max(n_lines, 1));
+
+    long long total = 0;
+    for (int i = 1; i <= n_lines; i++) total += wet_cells[i] + 1;
+
+    // Cut the lines where the running total passes each chunk's share
+    firsts.clear();
+    lasts.clear();
+    long long sum = 0;
+    int start = 1;
+    for (int i = 1; i <= n_lines; i++)
+    {
+      sum += wet_cells[i] + 1;
+      long long target = total * (chunks() + 1) / n_chunks;
+      int lines_left = n_lines - i;
+      int chunks_left = n_chunks - chunks() - 1;
+      if ((sum >= target && lines_left >= chunks_left) ||
+          lines_left == chunks_left)
+      {
+        firsts.push_back(start);
+        lasts.push_back(i);
+        start = i + 1;
+        if (chunks() == n_chunks) break;
+      }
+    }
+  }
+
+  /// The OpenMP schedule the chunk loops are run with: chunk c goes to
+  /// thread c, except in the dynamic schedule, where the threads take the
+  /// next chunk as they finish the last one.
+  static void run_schedule(LSDScheduleMode mode_in)
+  {
+    #ifdef _OPENMP
+    if (mode_in == DYNAMIC_SCHEDULE) omp_set_schedule(omp_sched_dynamic, 1);
+    else omp_set_schedule(omp_sched_static, 1);
+    #endif
+  }
+
+  /// Parses a schedule name ("static", "weighted" or "dynamic").
+  /// @return false if the name is not recognised.
+  static bool parse_mode(const std::string& name, LSDScheduleMode& mode_out)
+  {
+    if (name == "static") mode_out = STATIC_SCHEDULE;
+    else if (name == "weighted") mode_out = WEIGHTED_SCHEDULE;
+    else if (name == "dynamic") mode_out = DYNAMIC_SCHEDULE;
+    else return false;
+    return true;
+  }
+
+  static std::string mode_name(LSDScheduleMode mode_in)
+  {
+    switch (mode_in)
+    {
+      case WEIGHTED_SCHEDULE: return "weighted";
+      case DYNAMIC_SCHEDULE: return "dynamic";
+      default: return "static";
+    }
+  }
+
+private:
+
+  void split_evenly(int threads)
+  {
+    int n_chunks = std::min(std::max(threads, 1), std::max(n_lines, 1));
+    firsts.clear();
+    lasts.clear();
+    for (int c = 0; c < n_chunks; c++)
+    {
+      int lo = 1 + static_cast<int>(static_cast<long long>(n_lines) * c / n_chunks);
+      int hi = static_cast<int>(static_cast<long long>(n_lines) * (c + 1) / n_chunks);
+      if (hi < lo) continue;
+      firsts.push_back(lo);
+      lasts.push_back(hi);
+    }
+  }
+
+  LSDScheduleMode mode;
+  int n_lines;
+  std::vector<int> firsts;
+  std::vector<int> lasts;
+};
+
+#endif
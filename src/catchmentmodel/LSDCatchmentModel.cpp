@@ -53,12 +53,14 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <climits>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <iterator> // For the printing vector method
 #include <sys/stat.h> // For errors
 #include <cstdio> // Only for the debug macro
+#include <cstring> // memmove, for the wet lists
 
 #include "catchmentmodel/LSDCatchmentModel.hpp"
 #include "catchmentmodel/LSDUtils.hpp"
@@ -68,6 +70,16 @@
 
 using namespace LSDUtils;
 
+// A list of one value per grain size fraction, indexed like the grain
+// records: [1..fractions], with the unused entries 0 and G_MAX zero.
+static std::vector<double> parse_fraction_list(const std::string& value)
+{
+  std::vector<double> list = parse_number_list(value);
+  list.insert(list.begin(), 0.0);
+  list.push_back(0.0);
+  return list;
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // CREATE FUCNTIONS
 // These define what happens when an LSDCatchmentModel object is created
@@ -198,7 +210,7 @@ void LSDCatchmentModel::load_data()
     // Check that there is an outlet for the catchment water
     check_DEM_edge_condition();
 
-    // deep copy needed? -- DAV 2/12/2015
+    // LSDGrid copies are deep, so this is a snapshot of the starting DEM
     init_elevs = elev;
 
   }
@@ -313,7 +325,7 @@ void LSDCatchmentModel::load_data()
     try
     {
       bedrockR.read_ascii_raster(BEDROCK_FILENAME);
-      bedrock = bedrockR.get_RasterData_dbl();
+      bedrock = LSDGrid<double>(bedrockR.get_RasterData_dbl(), -9999);
       std::cout << "The bedrock file: " << BEDROCK_FILENAME
                 << " was successfully read." << std::endl;
     }
@@ -603,6 +615,27 @@ void LSDCatchmentModel::load_data()
       exit(EXIT_FAILURE);
     }
   }
+
+  // Split the domain into tiles and flag the ones that hold any data
+  tiles = LSDTileMap(imax, jmax, tile_size);
+  tiles.find_valid(elev);
+  std::cout << "Domain tiles: " << tiles.count_valid() << " of "
+            << tiles.tiles_x() * tiles.tiles_y() << " hold data" << std::endl;
+
+  // Even splits of the lines until the first wet area scan
+  int threads = 1;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  threads = omp_get_max_threads();
+  #endif
+  column_work = LSDWorkPartition(work_schedule, jmax, threads);
+  row_work = LSDWorkPartition(work_schedule, imax, threads);
+  LSDWorkPartition::run_schedule(work_schedule);
+
+  landslide_changed = LSDGrid<unsigned char>(imax + 2, jmax + 2, 0);
+  landslide_changed_cells.assign(threads, std::vector<int>());
+
+  place_arrays();
+  select_kernels();
 }
 
 // Reads in grain data from the grain data file,
@@ -636,10 +669,24 @@ void LSDCatchmentModel::ingest_graindata_from_file(
     std::vector<std::string> line_vector;
     // Strip using the function in LSDStatsTools
     split_delimited_string(line, ' ', line_vector);
+    if (line_vector.empty()) continue;
 
     unsigned col_counter = 1;
     grain_array_tot++;
 
+    // x, y and index, the surface fractions and the strata
+    const unsigned columns = 3 + (G_MAX + 1) + strata_layers * (G_MAX - 1);
+    if (line_vector.size() < columns)
+    {
+      std::cout << "\n FATAL ERROR: the grain data file has "
+                << line_vector.size() << " columns, but " << columns
+                << " are needed for " << G_MAX - 1 << " grain sizes and "
+                << strata_layers << " strata layers." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    grain.reserve(grain_array_tot + 1);
+    strata.reserve(grain_array_tot + 1);
+
     for (unsigned x=0; x<=line_vector.size()-1; x++ )
     {
       //std::cout << "LINE VECTOR IS: " << line_vector[x] << std::endl;
@@ -664,14 +711,13 @@ void LSDCatchmentModel::ingest_graindata_from_file(
         }
       }
 
-      // Now the fractions for the subsuface strata,
-      // note that this is currently hard coded as 10 layers
-      // so when you update to have user-defined no. of strata, recompile
-      for(int z=0; z<=9; z++)
+      // Now the fractions for the subsuface strata, strata_layers
+      // layers of G_MAX-1 fractions
+      for(unsigned z=0; z<strata_layers; z++)
       {
         for (unsigned n=0; n<=(G_MAX-2); n++)
         {
-          if (col_counter == (4+G_MAX+n+1) + (z*9))
+          if (col_counter == (4+G_MAX+n+1) + (z*(G_MAX-1)))
           {
             strata[grain_array_tot][z][n] = std::stod(line_vector[x]);
           }
@@ -1173,6 +1219,31 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
       ERODEFACTOR = atof(value.c_str());
       std::cout << "erosion limit per timestep: " << ERODEFACTOR << std::endl;
     }
+    else if (lower == "erode_timestep_type")
+    {
+      erode_timestep_type = atoi(value.c_str());
+      if (erode_timestep_type != 0 && erode_timestep_type != 1)
+      {
+        std::cout << "Unknown erode_timestep_type: " << value << std::endl;
+        std::cout << "You must specify 0 (erosion sets the time step) "
+                  << "or 1 (erosion keeps its own time step)" << std::endl;
+        std::cout << "Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << "Erosion time step type: " << erode_timestep_type << std::endl;
+    }
+    else if (lower == "morphological_factor")
+    {
+      morphological_factor = atof(value.c_str());
+      if (morphological_factor < 1)
+      {
+        std::cout << "Invalid morphological_factor: " << value << std::endl;
+        std::cout << "It must be 1 (no acceleration) or more" << std::endl;
+        std::cout << "Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << "Morphological factor: " << morphological_factor << std::endl;
+    }
 
     /// LATERAL EROSION ROUTINE PARAMETERS
     else if (lower == "lateral_erosion_on")
@@ -1217,6 +1288,35 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
       grain_data_file = value;
       std::cout << "grain_data_file: " << grain_data_file << std::endl;
     }
+    else if (lower == "grain_sizes")
+    {
+      grain_sizes = parse_fraction_list(value);
+      G_MAX = grain_sizes.size() - 1;
+      std::cout << "grain size fractions: " << G_MAX - 1 << std::endl;
+    }
+    else if (lower == "grain_proportions")
+    {
+      dprop = parse_fraction_list(value);
+      std::cout << "grain proportions given for " << dprop.size() - 2
+                << " fractions" << std::endl;
+    }
+    else if (lower == "fall_velocities")
+    {
+      fall_velocities = parse_fraction_list(value);
+      std::cout << "fall velocities given for " << fall_velocities.size() - 2
+                << " fractions" << std::endl;
+    }
+    else if (lower == "strata_layers")
+    {
+      strata_layers = atoi(value.c_str());
+      std::cout << "strata layers: " << strata_layers << std::endl;
+    }
+    else if (lower == "transport_table_tolerance")
+    {
+      transport_table_tolerance = atof(value.c_str());
+      std::cout << "transport table tolerance: " << transport_table_tolerance
+                << std::endl;
+    }
     //=-=-=-=-=-=-=-=-=-=-=-=
     // Bedrock Erosion
     //=-=-=-=-=-=-=-=-=-=-=-=
@@ -1293,6 +1393,28 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
       std::cout << "in-output difference allowed (cumecs): "
                 << in_out_difference_allowed << std::endl;
     }
+    else if (lower == "quasi_steady_tolerance")
+    {
+      quasi_steady_tolerance = atof(value.c_str());
+      std::cout << "Quasi-steady flow tolerance: " << quasi_steady_tolerance << std::endl;
+    }
+    else if (lower == "quasi_steady_iterations")
+    {
+      quasi_steady_iterations = atoi(value.c_str());
+      if (quasi_steady_iterations < 1)
+      {
+        std::cout << "Invalid quasi_steady_iterations: " << value << std::endl;
+        std::cout << "It must be 1 or more" << std::endl;
+        std::cout << "Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << "Quasi-steady flow iterations: " << quasi_steady_iterations << std::endl;
+    }
+    else if (lower == "quasi_steady_bed_change")
+    {
+      quasi_steady_bed_change = atof(value.c_str());
+      std::cout << "Quasi-steady flow bed change (m): " << quasi_steady_bed_change << std::endl;
+    }
 
     else if (lower == "min_q_for_depth_calc")
     {
@@ -1550,6 +1672,18 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
       std::cout << "Hillslope creep rate: " << CREEP_RATE << std::endl;
     }
 
+    else if (lower == "implicit_creep")
+    {
+      implicit_creep = (value == "yes") ? true:false;
+      std::cout << "Implicit creep: " << implicit_creep << std::endl;
+    }
+
+    else if (lower == "creep_interval_days")
+    {
+      creep_interval_days = atof(value.c_str());
+      std::cout << "Creep interval (days): " << creep_interval_days << std::endl;
+    }
+
     else if (lower == "slope_failure_thresh")
     {
       failureangle = atof(value.c_str());
@@ -1557,6 +1691,19 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
                 << failureangle << std::endl;
     }
 
+    else if (lower == "coloured_channel_landsliding")
+    {
+      coloured_channel_landsliding = (value == "yes") ? true:false;
+      std::cout << "Coloured in-channel landsliding: "
+                << coloured_channel_landsliding << std::endl;
+    }
+
+    else if (lower == "landslide_worklist")
+    {
+      landslide_worklist = (value == "yes") ? true:false;
+      std::cout << "Landslide worklist: " << landslide_worklist << std::endl;
+    }
+
     else if (lower == "soil_erosion_rate")
     {
       SOIL_RATE = atof(value.c_str());
@@ -1570,6 +1717,89 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
                 << soil_j_mean_depends_on << std::endl;
     }
 
+    // Performance
+    else if (lower == "row_major_traversal")
+    {
+      row_major_traversal = (value == "yes") ? true:false;
+      std::cout << "Row-major (contiguous) hydro traversal: "
+                << row_major_traversal << std::endl;
+    }
+
+    else if (lower == "simd_flow_route")
+    {
+      simd_flow_route = value;
+      std::cout << "Vectorised flow routing kernels: "
+                << simd_flow_route << std::endl;
+    }
+
+    else if (lower == "incremental_wet_scan")
+    {
+      incremental_wet_scan = (value == "yes") ? true:false;
+      std::cout << "Incremental wet cell scan: "
+                << incremental_wet_scan << std::endl;
+    }
+
+    else if (lower == "fused_hydro_step")
+    {
+      fuse_hydro_step = (value == "yes") ? true:false;
+      std::cout << "Fused hydro step: " << fuse_hydro_step << std::endl;
+    }
+
+    else if (lower == "tile_size")
+    {
+      tile_size = atoi(value.c_str());
+      std::cout << "Domain tile size: " << tile_size << std::endl;
+    }
+
+    else if (lower == "specialised_kernels")
+    {
+      specialised_kernels = (value == "yes") ? true:false;
+      std::cout << "Option specialised kernels: " << specialised_kernels
+                << std::endl;
+    }
+
+    else if (lower == "work_schedule")
+    {
+      if (!LSDWorkPartition::parse_mode(value, work_schedule))
+      {
+        std::cout << "Unknown work_schedule: " << value << std::endl;
+        std::cout << "You must specify one of 'static', 'weighted' "
+                  << "or 'dynamic'" << std::endl;
+        std::cout << "Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << "Work schedule: "
+                << LSDWorkPartition::mode_name(work_schedule) << std::endl;
+    }
+
+    else if (lower == "numa_first_touch")
+    {
+      numa_first_touch = (value == "yes") ? true:false;
+      std::cout << "Option NUMA first touch placement: " << numa_first_touch
+                << std::endl;
+    }
+
+    else if (lower == "thread_affinity")
+    {
+      if (!LSDPlacement::parse_affinity(value, thread_affinity))
+      {
+        std::cout << "Unknown thread_affinity: " << value << std::endl;
+        std::cout << "You must specify one of 'none', 'close' "
+                  << "or 'spread'" << std::endl;
+        std::cout << "Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      std::cout << "Thread affinity: "
+                << LSDPlacement::affinity_name(thread_affinity) << std::endl;
+    }
+
+    else if (lower == "placement_report")
+    {
+      placement_report = (value == "yes") ? true:false;
+      std::cout << "Option placement report: " << placement_report
+                << std::endl;
+    }
+
     // Debugging
     else if (lower == "debug_print_cycle")
     {
@@ -1607,6 +1837,35 @@ void LSDCatchmentModel::initialise_variables(std::string pname,
     rfnum = 1;
   }
 
+  check_grain_sizes();
+}
+
+void LSDCatchmentModel::check_grain_sizes()
+{
+  const unsigned fractions = G_MAX - 1;
+  if (fractions < 1 || fractions > MAX_FRACTIONS)
+  {
+    std::cout << "\n FATAL ERROR: grain_sizes must give between 1 and "
+              << MAX_FRACTIONS << " grain sizes." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (dprop.size() != G_MAX + 1)
+  {
+    std::cout << "\n FATAL ERROR: grain_proportions must give a proportion "
+              << "for each of the " << fractions << " grain sizes." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (!fall_velocities.empty() && fall_velocities.size() != G_MAX + 1)
+  {
+    std::cout << "\n FATAL ERROR: fall_velocities must give a fall velocity "
+              << "for each of the " << fractions << " grain sizes." << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (strata_layers < 1)
+  {
+    std::cout << "\n FATAL ERROR: strata_layers must be at least 1." << std::endl;
+    exit(EXIT_FAILURE);
+  }
 }
 // Initialise the arrays (as done in initialise() )
 // Not sure the point of having them declared in header file if you
@@ -1621,34 +1880,34 @@ void LSDCatchmentModel::initialise_arrays()
 
   // Need to change this so it does not waste memory assigning arrays
   // when running in hydro mode etc.
-  elev = TNT::Array2D<double> (imax+2,jmax+2, -9999);
-  water_depth = TNT::Array2D<double> (imax+2,jmax+2, 0.0);
+  elev = LSDGrid<double> (imax+2,jmax+2, -9999);
+  water_depth = LSDGrid<hydro_real> (imax+2,jmax+2, 0.0);
 
   // Cast to int and then double, what?
   //old_j_mean_store = new double[(int)((maxcycle*60)/reach_input_data_timestep)+10];
   old_j_mean_store = std::vector<double>
     (static_cast<int>((maxcycle*60)/reach_input_data_timestep)+10);  // TODO what does this have to do with reach mode?!
 
-  qx = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
-  qy = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
+  qx = LSDGrid<hydro_real> (imax + 2, jmax + 2, 0.0);
+  qy = LSDGrid<hydro_real> (imax + 2, jmax + 2, 0.0);
 
-  qxs = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
-  qys = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
+  qxs = LSDGrid<double> (imax + 2, jmax + 2, 0.0);
+  qys = LSDGrid<double> (imax + 2, jmax + 2, 0.0);
 
-  Vel = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
+  Vel = LSDGrid<hydro_real> (imax + 2, jmax + 2, 0.0);
 
-  area = TNT::Array2D<double> (imax+2, jmax + 2, 0.0);
-  index = TNT::Array2D<int> (imax +2, jmax + 2, 0);
-  elev_diff = TNT::Array2D<double> (imax + 2, jmax + 2);
+  area = LSDGrid<double> (imax+2, jmax + 2, 0.0);
+  index = LSDGrid<int> (imax +2, jmax + 2, 0);
+  elev_diff = LSDGrid<double> (imax + 2, jmax + 2);
 
-  bedrock = TNT::Array2D<double> (imax+2, jmax+2, -9999);
-  tempcreep = TNT::Array2D<double> (imax+2,jmax+2);
-  init_elevs = TNT::Array2D<double> (imax+2,jmax+2, -9999);
+  bedrock = LSDGrid<double> (imax+2, jmax+2, -9999);
+  tempcreep = LSDGrid<double> (imax+2,jmax+2);
+  init_elevs = LSDGrid<double> (imax+2,jmax+2, -9999);
 
-  vel_dir = TNT::Array3D<double> (imax+2, jmax+2, 9, 0.0);
-  Vsusptot = TNT::Array2D<double> (imax+2,jmax+2, 0.0);
+  vel_dir = TNT::Array3D<hydro_real> (imax+2, jmax+2, 9, 0.0);
+  Vsusptot = LSDGrid<double> (imax+2,jmax+2, 0.0);
 
-  spat_var_mannings = TNT::Array2D<double> (imax+2, jmax+2, 0.0);
+  spat_var_mannings = LSDGrid<double> (imax+2, jmax+2, 0.0);
 
   //inpoints=new int[10,2];
   //inputpointsarray = new bool[xmax + 2, jmax + 2];
@@ -1672,8 +1931,58 @@ void LSDCatchmentModel::initialise_arrays()
   //}
 
 
-  //cross_scan = TNT::Array2D<int> (imax+2,jmax+2, 0);
-  down_scan = TNT::Array2D<int> (jmax+2, imax+2, 0);
+  std::cout << "Hydrodynamic state precision: " << HYDRO_PRECISION_NAME
+            << std::endl;
+
+  // The vectorised flow kernels work along rows, so they need the
+  // row-major wet list.
+  #ifdef LSD_SINGLE_PRECISION
+  if (simd_flow_route != "no")
+  {
+    // The kernels work on double rows; float storage uses the scalar code
+    std::cout << "The vectorised flow kernels need a double precision "
+              << "build. Using the scalar flow routing." << std::endl;
+    simd_flow_route = "no";
+  }
+  #endif
+  if (simd_flow_route != "no")
+  {
+    std::string chosen;
+    face_kernel = LSDFlowKernels::select_face_kernel(simd_flow_route, chosen);
+    std::cout << "Flow routing kernel instruction set: " << chosen << std::endl;
+    if (face_kernel != NULL) row_major_traversal = true;
+  }
+
+  // The fused hydro step also works along rows. It cannot slot the
+  // groundwater input in between the flux and depth updates.
+  if (fuse_hydro_step && groundwater_on)
+  {
+    std::cout << "The fused hydro step does not work with groundwater, "
+              << "using the separate steps" << std::endl;
+    fuse_hydro_step = false;
+  }
+  if (fuse_hydro_step)
+  {
+    row_major_traversal = true;
+    edge_outflow_left = std::vector<double> (imax+2, 0.0);
+    edge_outflow_right = std::vector<double> (imax+2, 0.0);
+    edge_outflow_top = std::vector<double> (jmax+2, 0.0);
+    edge_outflow_bottom = std::vector<double> (jmax+2, 0.0);
+  }
+
+  down_scan = LSDGrid<int> (jmax+2, imax+2, 0);
+  if (row_major_traversal)
+  {
+    cross_scan = LSDGrid<int> (imax+2, jmax+2, 0);
+  }
+  if (incremental_wet_scan)
+  {
+    down_scan_len = std::vector<int> (jmax+2, 0);
+    cross_scan_len = std::vector<int> (imax+2, 0);
+    wet_state = LSDGrid<unsigned char> (imax+2, jmax+2, 0);
+    wet_neighbours = LSDGrid<int> (imax+2, jmax+2, 0);
+    wet_pending = LSDGrid<unsigned char> (imax+2, jmax+2, 0);
+  }
 
   // line to stop max time step being greater than rain time step
   if (rain_data_time_step < 1) rain_data_time_step = 1;
@@ -1711,15 +2020,15 @@ void LSDCatchmentModel::initialise_arrays()
 
   inputpointsarray = TNT::Array2D <bool> (imax + 2, jmax + 2);
 
-  edge = TNT::Array2D<double> (imax+1,jmax+1, 0.0);
-  edge2 = TNT::Array2D<double> (imax+1,jmax+1, 0.0);
+  edge = LSDGrid<double> (imax+1,jmax+1, 0.0);
+  edge2 = LSDGrid<double> (imax+1,jmax+1, 0.0);
 
-  Tau = TNT::Array2D<double> (imax+2,jmax+2, 0.0);
+  Tau = LSDGrid<hydro_real> (imax+2,jmax+2, 0.0);
 
   catchment_input_x_coord = std::vector<int> (jmax * imax, 0);
   catchment_input_y_coord = std::vector<int> (jmax * imax, 0);
 
-  area_depth = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
+  area_depth = LSDGrid<double> (imax + 2, jmax + 2, 0.0);
 
   // Grain Arrays
   sum_grain = std::vector<double> (G_MAX+1);
@@ -1750,14 +2059,17 @@ void LSDCatchmentModel::initialise_arrays()
   // Only need these ones for erosion-enabled simulation runs
   if (!hydro_only)
   {
-    sr = TNT::Array3D<double> (imax + 2, jmax + 2, 10, 0.0);
-    sl = TNT::Array3D<double> (imax + 2, jmax + 2, 10, 0.0);
-    su = TNT::Array3D<double> (imax + 2, jmax + 2, 10, 0.0);
-    sd = TNT::Array3D<double> (imax + 2, jmax + 2, 10, 0.0);
-    ss = TNT::Array2D<double> (imax + 2, jmax + 2, 0.0);
-
-    strata = TNT::Array3D<double> ( ((imax+2)*(jmax+2))/LIMIT , 10, G_MAX+1, 0.0);
-    grain = TNT::Array2D<double> ( ((2+imax)*(jmax+2))/LIMIT, G_MAX+1 , 0.0);
+    bedload = TNT::Array3D<double> (imax + 2, jmax + 2, G_MAX, 0.0);
+    ss = LSDGrid<double> (imax + 2, jmax + 2, 0.0);
+    erosion_rate = TNT::Array3D<double> (imax + 2, jmax + 2, G_MAX, 0.0);
+    erosion_weight = TNT::Array3D<double> (imax + 2, jmax + 2, 4, 0.0);
+    eroding_cells = LSDGrid<int> (jmax + 2, imax + 2, 0);
+    lateral_take = TNT::Array3D<double> (imax + 2, jmax + 2, 2, 0.0);
+    lateral_grain = TNT::Array3D<double> (imax + 2, jmax + 2, 2 * (G_MAX + 1), 0.0);
+
+    // The records are only allocated as cells are given them (see addGS())
+    strata = LSDStrataPool ( ((imax+2)*(jmax+2))/LIMIT , strata_layers, G_MAX+1);
+    grain = LSDGrainPool ( ((2+imax)*(jmax+2))/LIMIT, G_MAX+1);
     temp_grain = std::vector<double> (G_MAX+1, 0.0);
   }
   // Initialise suspended fraction vector
@@ -1765,6 +2077,7 @@ void LSDCatchmentModel::initialise_arrays()
   isSuspended = std::vector<bool>(G_MAX+1, false);
   fallVelocity = std::vector<double>(G_MAX+1, 0.0);
   set_fall_velocities();
+  set_transport_constants();
 
   // Reach mode
   if (reach_mode_opt)
@@ -1842,11 +2155,17 @@ void LSDCatchmentModel::initialise_arrays()
   zero_values();
 }
 
-// Hard coded! - Should make this read from sediment details file.
+// From the fall_velocities parameter if it was given, otherwise hard
+// coded for the default (Swale) grain sizes, and zero for any others.
 // DAV 3/12/2015
-// TODO Allow user to set these values.
 void LSDCatchmentModel::set_fall_velocities()
 {
+  if (!fall_velocities.empty())
+  {
+    fallVelocity = fall_velocities;
+    return;
+  }
+  if (G_MAX != 10) return;
   fallVelocity[0] = 0.0;
   fallVelocity[1] = 0.033;
   fallVelocity[2] = 0.109;
@@ -1859,6 +2178,34 @@ void LSDCatchmentModel::set_fall_velocities()
   fallVelocity[9] = 1.357;
 }
 
+void LSDCatchmentModel::set_transport_constants()
+{
+  log_grain_sizes = std::vector<double>(G_MAX + 1, 0.0);
+  einstein_psi_size = std::vector<double>(G_MAX + 1, 0.0);
+  einstein_settling = std::vector<double>(G_MAX + 1, 0.0);
+  for (unsigned n = 1; n <= G_MAX - 1; n++)
+  {
+    const double Di = grain_sizes[n];
+    log_grain_sizes[n] = std::log(Di);
+    einstein_psi_size[n] = (2650 - 1000) * Di;
+    einstein_settling[n] = std::sqrt(1000 / ((2250 - 1000) * gravity * (Di * Di * Di)));
+  }
+
+  use_transport_tables = (transport_table_tolerance > 0 && wilcock && !hydro_only);
+  if (!use_transport_tables) return;
+
+  const bool built = wilcock_tables.build(
+    log_grain_sizes[G_MAX - 1] - log_grain_sizes[1], transport_table_tolerance);
+  std::cout << "Transport tables: " << wilcock_tables.points()
+            << " points (largest error " << wilcock_tables.max_error() << ")"
+            << std::endl;
+  if (!built)
+  {
+    std::cout << "Warning: the transport tables could not be made as accurate as "
+              << "transport_table_tolerance asks." << std::endl;
+  }
+}
+
 void LSDCatchmentModel::set_time_counters()
 {
   save_time = cycle;
@@ -1868,6 +2215,8 @@ void LSDCatchmentModel::set_time_counters()
   soil_erosion_time = cycle;
   soil_development_time = cycle;
   time_1 = cycle;
+  erosion_cycle = cycle;
+  morphological_start = cycle;
 }
 
 void LSDCatchmentModel::set_loop_cycle()
@@ -1932,6 +2281,12 @@ void LSDCatchmentModel::increment_counters()
   new_cycle = std::fmod(cycle, output_file_save_interval);
 }
 
+double LSDCatchmentModel::morphological_time(double model_cycle) const
+{
+  return morphological_start
+         + (model_cycle - morphological_start) * morphological_factor;
+}
+
 void LSDCatchmentModel::save_raster_output()
 {
   if (cycle >= save_time)
@@ -1941,11 +2296,76 @@ void LSDCatchmentModel::save_raster_output()
   }
 }
 
+void LSDCatchmentModel::print_hydro_throughput()
+{
+  std::cout << "Hydro kernels ("
+            << (fuse_hydro_step ? "fused hydro step" : "flow_route + depth_update")
+            << "), "
+            << (row_major_traversal ? "row-major" : "column-wise")
+            << " traversal: " << hydro_cells_processed
+            << " wet cell updates in " << hydro_kernel_seconds << " s";
+  if (hydro_kernel_seconds > 0)
+  {
+    std::cout << " (" << hydro_cells_processed / hydro_kernel_seconds
+              << " cells/s)";
+  }
+  std::cout << std::endl;
+  std::cout << "Wet area scans ("
+            << (incremental_wet_scan ? "incremental" : "full") << "): "
+            << wet_scan_seconds << " s" << std::endl;
+  if (active_fraction_samples > 0)
+  {
+    std::cout << "Mean active (wet list) fraction of the domain: "
+              << active_fraction_sum / active_fraction_samples << std::endl;
+  }
+  if (!hydro_only)
+  {
+    std::cout << "Erosion (" << (specialised_kernels ? "specialised" : "generic")
+              << " kernels): " << erosion_seconds << " s" << std::endl;
+    if (erode_timestep_type == 1)
+    {
+      std::cout << "Erosion steps: " << erosion_substeps << " in "
+                << erosion_calls << " calls" << std::endl;
+    }
+    std::cout << "In-channel landsliding ("
+              << (coloured_channel_landsliding ? "coloured" : "serial") << "): "
+              << channel_landslide_seconds << " s" << std::endl;
+    std::cout << "Creep (" << (implicit_creep ? "implicit" : "explicit") << "): "
+              << creep_steps << " steps";
+    if (implicit_creep)
+    {
+      std::cout << ", " << creep_cg_iterations << " conjugate gradient iterations";
+    }
+    std::cout << " in " << creep_seconds << " s" << std::endl;
+    std::cout << "Global landsliding ("
+              << (landslide_worklist ? "worklist" : "full sweeps") << "): "
+              << landslide_sweeps << " sweeps, " << landslide_cell_visits
+              << " cell visits in " << landslide_seconds << " s" << std::endl;
+    std::cout << "Grain size records: " << grain_array_tot << " of "
+              << grain.max_records() << " ("
+              << (grain.bytes() + strata.bytes()) / (1024.0 * 1024.0)
+              << " MB allocated)" << std::endl;
+  }
+  if (quasi_steady_tolerance > 0)
+  {
+    std::cout << "Quasi-steady flow: frozen " << quasi_steady_freezes
+              << " times, for " << frozen_iterations << " of " << counter
+              << " iterations" << std::endl;
+  }
+}
+
 void LSDCatchmentModel::print_cycle()
 {
   if (DEBUG_print_cycle_on==true)
   {
-  std::cout << "Cycle: " << cycle << "                  \r" << std::flush;
+  std::cout << "Cycle: " << cycle;
+  if (incremental_wet_scan)
+  {
+    std::cout << "  active: " << std::fixed << std::setprecision(1)
+              << 100.0 * active_cells / (imax * jmax) << "%"
+              << std::defaultfloat << std::setprecision(6);
+  }
+  std::cout << "                  \r" << std::flush;
   }
 }
 
@@ -1976,10 +2396,17 @@ void LSDCatchmentModel::call_channel_landsliding(int in_channel_landslide_iter_i
 void LSDCatchmentModel::slope_creep(int creep_time_interval_days,
                                     double creep_coeff)
 {
+  if (creep_interval_days > 0)
+  {
+    // Keep creep_coeff (years) in step with the interval (minutes)
+    creep_coeff *= creep_interval_days * 1440 / creep_time_interval_days;
+    creep_time_interval_days = static_cast<int>(creep_interval_days * 1440);
+  }
   if (!hydro_only && (cycle > creep_time))
   {
     creep_time += creep_time_interval_days; // Add 10 days
-    creep(creep_coeff);  // Make this number user selectable
+    // (10 days of flow are morphological_factor times as many of creep)
+    creep(creep_coeff * morphological_factor);  // Make this number user selectable
   }
 }
 
@@ -2012,15 +2439,31 @@ void LSDCatchmentModel::grow_vegetation(int vegetation_growth_interval_hours)
   {
     // Add 1 day in hours
     grass_grow_interval += vegetation_growth_interval_hours;
-    grow_grass(1 / (grow_grass_time * 365));
+    grow_grass(morphological_factor / (grow_grass_time * 365));
   }
 }
 
 void LSDCatchmentModel::check_wetted_area(int scan_area_interval_iter)
 {
-  if ((counter % scan_area_interval_iter) == 0)
+  // (the depths of a frozen flow do not change)
+  if (!quasi_steady_frozen && (counter % scan_area_interval_iter) == 0)
   {
-    scan_area();
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    double scan_start = omp_get_wtime();
+    #endif
+    if (incremental_wet_scan)
+    {
+      update_wet_frontier();
+    }
+    else
+    {
+      scan_area();
+    }
+    refresh_tile_wet_state();
+    rebuild_work_partitions();
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    wet_scan_seconds += omp_get_wtime() - scan_start;
+    #endif
   }
 }
 
@@ -2280,7 +2723,13 @@ void LSDCatchmentModel::call_erosion()
   // erode_call is by default zero,
   // so don't call erosion before water has been routed.
   {
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    double erode_start = omp_get_wtime();
+    #endif
     erode_mult = static_cast<int>(ERODEFACTOR / erode(erode_mult) );
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    erosion_seconds += omp_get_wtime() - erode_start;
+    #endif
     if (erode_mult < 1)
     {
       erode_mult = 1;
@@ -2461,6 +2910,16 @@ void LSDCatchmentModel::output_data()
         Qg_hour_format << std::fixed << std::setprecision(10) << Qg_hour[n];
         output = output + " " + Qg_hour_format.str();
       }
+
+      // With a morphological factor, the morphological time (hours) the
+      // row is at
+      if (morphological_factor != 1)
+      {
+        std::stringstream morph_hours_format;
+        morph_hours_format << std::fixed << std::setprecision(2)
+                           << morphological_time(Tx) / 60;
+        output = output + " " + morph_hours_format.str();
+      }
       // Open the catchment time series file in append mode (ios_base::app)
       // Open it in write mode (ios_base::out)
       // write_fname is called "catchment.dat" by default (see the .hpp file)
@@ -2486,19 +2945,22 @@ void LSDCatchmentModel::output_data(double temptotal, runoffGrid& runoff)
   //for (int nn = 1; nn <= rfnum; nn++)
   for (unsigned i=1; i<=imax; i++)
   {
-    for (unsigned j=1; j<=jmax; j++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(i))
     {
-      if (elev[i][j] > no_data_value)
+      for (int j = span.first; j <= span.last; j++)
       {
-        Jw_newvol += (runoff.get_j_mean(i,j) * DX * DX ) * ((cycle - previous)*60);
+        if (elev[i][j] > no_data_value)
+        {
+          Jw_newvol += (runoff.get_j_mean(i,j) * DX * DX ) * ((cycle - previous)*60);
+        }
+        // originally j_mean[nn] * DX*DX* nActualGridCells[nn] ...
+        // needs checking because you don't want to include grid cells that are
+        // actually outside the catchment and shouldnt be contributing to the
+        // runoff output.
+        //
+        // The difference will be small since there will be hardly any runoff
+        // here, but nontheless it's a bug that should fixed - TODO: DAV
       }
-      // originally j_mean[nn] * DX*DX* nActualGridCells[nn] ...
-      // needs checking because you don't want to include grid cells that are
-      // actually outside the catchment and shouldnt be contributing to the
-      // runoff output.
-      //
-      // The difference will be small since there will be hardly any runoff
-      // here, but nontheless it's a bug that should fixed - TODO: DAV
     }
   }
 
@@ -2652,6 +3114,16 @@ void LSDCatchmentModel::output_data(double temptotal, runoffGrid& runoff)
         output = output + " " + Qg_hour_format.str();
       }
 
+      // With a morphological factor, the morphological time (hours) the
+      // row is at
+      if (morphological_factor != 1)
+      {
+        std::stringstream morph_hours_format;
+        morph_hours_format << std::fixed << std::setprecision(2)
+                           << morphological_time(Tx) / 60;
+        output = output + " " + morph_hours_format.str();
+      }
+
       // Open the catchment time series file in append mode (ios_base::app)
       // Open it in write mode (ios_base::out)
       // write_fname is called "catchment.dat" by default (see the .hpp file)
@@ -2679,7 +3151,7 @@ void LSDCatchmentModel::save_raster_data(double tempcycle)
     // which is incorrect technically
     // Find a way to trim these off.
     LSDRaster water_depthR(imax+2, jmax+2, xll, yll, DX,
-                          no_data_value, water_depth);
+                          no_data_value, water_depth.to_TNT<double>());
 
     // Strip the padding of zeros round the edge
     water_depthR.strip_raster_padding();
@@ -2697,7 +3169,7 @@ void LSDCatchmentModel::save_raster_data(double tempcycle)
   // Write Elevation raster
   if (write_elev_file == true)
   {
-    LSDRaster elev_outR(imax+2, jmax+2, xll, yll, DX, no_data_value, elev);
+    LSDRaster elev_outR(imax+2, jmax+2, xll, yll, DX, no_data_value, elev.to_TNT());
     // Get rid of the zeros padding the edges of the domain
     elev_outR.strip_raster_padding();
 
@@ -2711,9 +3183,10 @@ void LSDCatchmentModel::save_raster_data(double tempcycle)
   if (write_grainsz_file == true)
   {
     std::cout << "Entering the GRAINMATRIX..." << std::endl;
+    TNT::Array2D<int> index_out = index.to_TNT();
     LSDGrainMatrix grainsz_outR(imax, jmax, \
-                                no_data_value, G_MAX, \
-                                index, grain, strata);
+                                no_data_value, G_MAX, strata_layers, \
+                                index_out, grain, strata);
 
     std::string OUTPUT_GRAIN_FILE = write_path + "/" + grainsize_fname + \
       std::to_string((int)tempcycle);
@@ -2725,7 +3198,7 @@ void LSDCatchmentModel::save_raster_data(double tempcycle)
   // Write the elev diff file
   if (write_elevdiff_file == true)
   {
-    TNT::Array2D<double> elevdiff_now = init_elevs - elev;
+    TNT::Array2D<double> elevdiff_now = init_elevs.to_TNT() - elev.to_TNT();
 
     LSDRaster elevdiff_outR(imax+2, jmax+2, xll, yll,
                             DX, no_data_value, elevdiff_now);
@@ -2939,23 +3412,9 @@ void LSDCatchmentModel::zero_values()
     }
   }
 
+  // (The grain size records start at zero as they are allocated)
   for(unsigned i=1; i<((jmax*imax)/LIMIT); i++)
   {
-    if (!hydro_only)
-    {
-      for(unsigned j=0; j<=G_MAX; j++)
-      {
-        grain[i][j] = 0;
-      }
-      for(int z=0; z <= 9; z++)
-      {
-        for(unsigned j=0; j <= G_MAX-2; j++)
-        {
-          strata[i][z][j] =0;
-        }
-      }
-    }
-
     catchment_input_x_coord[i] = 0;
     catchment_input_y_coord[i] = 0;
   }
@@ -3005,20 +3464,32 @@ void LSDCatchmentModel::zero_values()
 void LSDCatchmentModel::water_flux_out()
 // Extracted as a seprate method from erodepo()
 {
+  if (edges_drained)
+  {
+    // Already done this iteration by fused_hydro_step()
+    edges_drained = false;
+    return;
+  }
+  // The outflow of a frozen flow field stays as it was
+  if (quasi_steady_frozen) return;
+
   double flow_timestep = time_step;
   // Zero the water, but then we set it to the minimum depth - DV
   temptot = 0;
+  // Edge cells in tiles that cannot hold water are skipped.
   for (unsigned i = 1; i <= imax; i++)
   {
     // RH Edge
-    if (water_depth[i][jmax] > water_depth_erosion_threshold)
+    if (tiles.wet_at(i, jmax)
+        && water_depth[i][jmax] > water_depth_erosion_threshold)
     {
       temptot += (water_depth[i][jmax] - water_depth_erosion_threshold) \
         * DX * DX / flow_timestep;
       water_depth[i][jmax] = water_depth_erosion_threshold;
     }
     // LH Edge
-    if (water_depth[i][1] > water_depth_erosion_threshold)
+    if (tiles.wet_at(i, 1)
+        && water_depth[i][1] > water_depth_erosion_threshold)
     {
       temptot += (water_depth[i][1] - water_depth_erosion_threshold) \
         * DX * DX / flow_timestep;
@@ -3029,14 +3500,16 @@ void LSDCatchmentModel::water_flux_out()
   for (unsigned j = 1; j <= jmax; j++)
   {
     // Top Edge
-    if (water_depth[1][j] > water_depth_erosion_threshold)
+    if (tiles.wet_at(1, j)
+        && water_depth[1][j] > water_depth_erosion_threshold)
     {
       temptot += (water_depth[1][j] - water_depth_erosion_threshold) \
         * DX * DX / flow_timestep;
       water_depth[1][j] = water_depth_erosion_threshold;
     }
     // Bottom Edge
-    if (water_depth[imax][j] > water_depth_erosion_threshold)
+    if (tiles.wet_at(imax, j)
+        && water_depth[imax][j] > water_depth_erosion_threshold)
     {
       temptot += (water_depth[imax][j] - water_depth_erosion_threshold) \
         * DX * DX / flow_timestep;
@@ -3047,201 +3520,726 @@ void LSDCatchmentModel::water_flux_out()
 }
 
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-// THE WATER ROUTING ALGORITHM: LISFLOOD-FP
-//
-// Originally derived in Bates et al (2010) Journal of Hydrology
-// The Lisflood-FP algorithm is a non steady state water flow
-// algorithm that uses a simplified version of the Saint-Venant
-// shallow water equations (see Hydrology textbooks) to calculate
-// water transport across the model.
-//
-// This algorithm was originally implemented in the CAESAR-Lisflood
-// model (2013), and remains broadly unchanged (except it's in C++)
+// QUASI-STEADY FLOW
 //
+// With a steady inflow (e.g. a reach run with a constant discharge) the
+// flow settles down, and flow_route() and depth_update() go on working out
+// the same depths and discharges, for most of the run time. Once the flow
+// has stopped changing, check_quasi_steady() freezes it: the hydro kernels
+// are skipped and only the erosion and slope processes run, until the
+// inflow or the bed changes enough to change the flow.
 //
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-void LSDCatchmentModel::flow_route()
+void LSDCatchmentModel::check_quasi_steady()
 {
-  double flow_timestep = get_flow_timestep();
-
-  #pragma omp parallel for
-  for (unsigned y=1; y<=jmax; y++)
-  {
-    int inc = 1;
-    while (down_scan[y][inc] > 0)
-    {
-      // This was a totally pointless idea but I leave it in to warn
-      // others of my folly... (DAV)
-////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]-1][y-1]);
-////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]-1][y]);
-////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]][y-1]);
-////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]][y]);
-////      __builtin_prefetch(&elev[down_scan[y][inc+1]-1][y]);
-////      __builtin_prefetch(&elev[down_scan[y][inc+1]-1][y-1]);
-////      __builtin_prefetch(&elev[down_scan[y][inc+1]][y]);
-////      __builtin_prefetch(&elev[down_scan[y][inc+1]][y-1]);
-
-      unsigned x = down_scan[y][inc];
-      inc++;
-      if (elev[x][y] > -9999) // to stop moving water in to -9999's on elev
+  if (quasi_steady_tolerance <= 0 || groundwater_on) return;
+
+  const double inflow = waterinput + reach_inflow;
+  const double last_step = steady_last_step;
+  steady_last_step = (cycle - previous) * 60;
+  if (quasi_steady_frozen)
+  {
+    frozen_iterations++;
+    // Let the flow go as soon as the inflow changes, or once the bed has
+    // moved enough to change it
+    bool thaw = std::abs(inflow - frozen_inflow) > quasi_steady_tolerance * frozen_inflow;
+    if (!thaw && ++quasi_steady_count >= quasi_steady_iterations)
+    {
+      quasi_steady_count = 0;
+      double bed_change = 0;
+      #pragma omp parallel for reduction(max:bed_change)
+      for (unsigned x = 1; x <= imax; x++)
       {
-        // SPATIAL MANNINGS
-        if (spatially_var_mannings)
+        for (unsigned y = 1; y <= jmax; y++)
         {
-            mannings = spat_var_mannings[x][y];
-        }
-        // routing in x direction
-        if ((water_depth[x][y] > 0 || water_depth[x - 1][y] > 0) \
-          && elev[x - 1][y] > -9999)
-          // need to check water and not -9999 on elev?
-        {
-          double hflow = std::max(elev[x][y] + water_depth[x][y],
-                                  elev[x - 1][y] + water_depth[x - 1][y]) \
-                                  - std::max(elev[x - 1][y], elev[x][y]);
-
-          if (hflow > hflow_threshold)
-          {
-            double tempslope = (((elev[x - 1][y] + water_depth[x - 1][y])) -
-                (elev[x][y] + water_depth[x][y])) / DX;
-
-            if (x == imax) tempslope = edgeslope;
-            if (x <= 2) tempslope = 0 - edgeslope;
-
-            //double oldqx = qx[x][y];
-            qx[x][y] = ((qx[x][y] - (gravity * hflow \
-                          * flow_timestep * tempslope)) \
-                          / (1 + gravity * hflow * flow_timestep \
-                          * (mannings * mannings) * std::abs(qx[x][y]) \
-                          / std::pow(hflow, (10 / 3))));
-            //if (oldqx != 0) qx[x][y] = (oldqx + qx[x][y]) / 2;
-
-            // need to have these lines to stop too much water moving from
-            // one cell to another - resulting in negative discharges
-            // which causes a large instability to develop
-            // - only in steep catchments really
-
-            // FROUDE NUBER CHECKS
-            if (qx[x][y] > 0 && (qx[x][y]
-                / hflow) / std::sqrt(gravity * hflow) > froude_limit )
-            {
-              qx[x][y] = hflow * (std::sqrt(gravity*hflow) * froude_limit );
-            }
-            // If the discahrge is now negative and above the froude_limit...
-            if (qx[x][y] < 0 && std::abs(qx[x][y] / hflow)
-                / std::sqrt(gravity * hflow) > froude_limit )
-            {
-              qx[x][y] = 0 - (hflow * (std::sqrt(gravity * hflow) * froude_limit ));
-            }
-
-            // DISCHARGE MAGNITUDE/TIMESTEP CHECKS
-            // If the discharge is too high for this timestep, scale back...
-            if (qx[x][y] > 0 && (qx[x][y] * flow_timestep / DX)
-                > (water_depth[x][y] / 4))
-            {
-              qx[x][y] = ((water_depth[x][y] * DX) / 5) / flow_timestep;
-            }
-            // If the discharge is negative and too large, scale back...
-            if (qx[x][y] < 0 && std::abs(qx[x][y] * flow_timestep / DX)
-              > (water_depth[x - 1][y] / 4))
-            {
-              qx[x][y] = 0 - ((water_depth[x - 1][y] * DX) / 5) / flow_timestep;
-            }
-
-            // Update suspended fraction discharges
-            if (isSuspended[1])
-            {
-              if (qx[x][y] > 0)
-              {
-                qxs[x][y] = qx[x][y] * (Vsusptot[x][y] / water_depth[x][y]);
-              }
-              if (qx[x][y] < 0)
-              {
-                qxs[x][y] = qx[x][y] \
-                  * (Vsusptot[x - 1][y] / water_depth[x - 1][y]);
-              }
-
-              if (qxs[x][y] > 0 && qxs[x][y] * flow_timestep
-                > (Vsusptot[x][y] * DX) / 4)
-              {
-                qxs[x][y] = ((Vsusptot[x][y] * DX) / 5) / flow_timestep;
-              }
-
-              if (qxs[x][y] < 0 && std::abs(qxs[x][y] * flow_timestep)
-                > (Vsusptot[x - 1][y] * DX) / 4)
-              {
-                qxs[x][y] = 0 - ((Vsusptot[x - 1][y] * DX) / 5) / flow_timestep;
-              }
-            }
-
-            // calc velocity now
-            if (qx[x][y] > 0)
-            {
-              vel_dir[x][y][7] = qx[x][y] / hflow;
-            }
-            if (qx[x][y] < 0)
-            {
-              vel_dir[x - 1][y][3] = (0- qx[x][y]) / hflow;
-            }
-
-          }
-          else
+          if (elev[x][y] > -9999)
           {
-            qx[x][y] = 0;
-            qxs[x][y] = 0;
+            bed_change = std::max(bed_change, std::abs(elev[x][y] - steady_elev[x][y]));
           }
         }
+      }
+      thaw = bed_change > quasi_steady_bed_change;
+    }
+    if (thaw)
+    {
+      quasi_steady_frozen = false;
+      quasi_steady_count = 0;
+    }
+    return;
+  }
 
-        //routing in the y direction
-        if ((water_depth[x][y] > 0 || water_depth[x][y - 1] > 0) && elev[x][y - 1] > -9999)
+  // Every quasi_steady_iterations iterations: the flow is steady if the
+  // share of the inflow that did not go out over them is the same as over
+  // the last ones. (Not that it is all going out: water is not quite
+  // conserved at the edges, so a steady flow can keep a small gap. The
+  // outflow of a single iteration also jumps about as the edge cells fill
+  // and drain, so the volumes are added up.)...
+  if (inflow <= 0)
+  {
+    quasi_steady_count = 0;
+    steady_gap = -1;
+    return;
+  }
+  if (quasi_steady_count == 0)
+  {
+    take_steady_snapshot(false);
+    steady_inflow_volume = 0;
+    steady_outflow_volume = 0;
+    steady_window_time = 0;
+  }
+  // (over the time the model moved on by, as output_data() counts them;
+  // waterOut is still the last iteration's)
+  steady_inflow_volume += inflow * (cycle - previous) * 60;
+  steady_outflow_volume += waterOut * last_step;
+  steady_window_time += last_step;
+  if (++quasi_steady_count < quasi_steady_iterations) return;
+  quasi_steady_count = 0;
+  const double last_gap = steady_gap;
+  steady_gap = (steady_inflow_volume - steady_outflow_volume) / steady_inflow_volume;
+  if (last_gap < 0 || std::abs(steady_gap - last_gap) > quasi_steady_tolerance
+      || steady_outflow_volume <= 0) return;
+
+  // ...and qx and qy have hardly changed
+  double change = 0;
+  double total = 0;
+  #pragma omp parallel for reduction(+:change,total)
+  for (unsigned x = 1; x <= imax; x++)
+  {
+    for (unsigned y = 1; y <= jmax; y++)
+    {
+      change += std::abs(qx[x][y] - steady_qx[x][y]) + std::abs(qy[x][y] - steady_qy[x][y]);
+      total += std::abs(qx[x][y]) + std::abs(qy[x][y]);
+    }
+  }
+  if (total > 0 && change <= quasi_steady_tolerance * total)
+  {
+    quasi_steady_frozen = true;
+    quasi_steady_freezes++;
+    frozen_inflow = inflow;
+    // The outflow stays at its mean (temptot is what the time series
+    // writes)
+    waterOut = steady_outflow_volume / steady_window_time;
+    temptot = waterOut;
+    take_steady_snapshot(true);
+  }
+}
+
+void LSDCatchmentModel::take_steady_snapshot(bool with_elev)
+{
+  if (steady_qx.dim1() == 0)
+  {
+    steady_qx = TNT::Array2D<double>(imax + 2, jmax + 2, 0.0);
+    steady_qy = TNT::Array2D<double>(imax + 2, jmax + 2, 0.0);
+    steady_elev = TNT::Array2D<double>(imax + 2, jmax + 2, 0.0);
+  }
+  #pragma omp parallel for
+  for (unsigned x = 1; x <= imax; x++)
+  {
+    for (unsigned y = 1; y <= jmax; y++)
+    {
+      steady_qx[x][y] = qx[x][y];
+      steady_qy[x][y] = qy[x][y];
+      if (with_elev) steady_elev[x][y] = elev[x][y];
+    }
+  }
+}
+
+// The suspended sediment discharge through a face with water discharge q,
+// taken from the cell on the high side of the face (here) if q > 0 and
+// from the one on the low side (there) if q < 0, as route_face_x() and
+// route_face_y() work it out.
+static inline double suspended_face_discharge(double q, double susp_here,
+                                              double depth_here,
+                                              double susp_there,
+                                              double depth_there,
+                                              double flow_timestep, double DX)
+{
+  double qs = 0;
+  if (q > 0 && depth_here > 0) qs = q * (susp_here / depth_here);
+  if (q < 0 && depth_there > 0) qs = q * (susp_there / depth_there);
+  if (qs > 0 && qs * flow_timestep > (susp_here * DX) / 4)
+  {
+    qs = ((susp_here * DX) / 5) / flow_timestep;
+  }
+  if (qs < 0 && std::abs(qs * flow_timestep) > (susp_there * DX) / 4)
+  {
+    qs = 0 - ((susp_there * DX) / 5) / flow_timestep;
+  }
+  return qs;
+}
+
+void LSDCatchmentModel::route_suspended_sediment()
+{
+  if (!suspended_opt) return;
+  const double flow_timestep = get_flow_timestep();
+
+  // The face discharges first, as flow_route() does...
+  #pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    for (int y = column_work.first(c); y <= column_work.last(c); y++)
+    {
+      int inc = 1;
+      while (down_scan[y][inc] > 0)
+      {
+        const unsigned x = down_scan[y][inc];
+        inc++;
+        if (elev[x][y] <= -9999) continue;
+        qxs[x][y] = suspended_face_discharge(qx[x][y], Vsusptot[x][y], water_depth[x][y],
+                                             Vsusptot[x - 1][y], water_depth[x - 1][y],
+                                             flow_timestep, DX);
+        qys[x][y] = suspended_face_discharge(qy[x][y], Vsusptot[x][y], water_depth[x][y],
+                                             Vsusptot[x][y - 1], water_depth[x][y - 1],
+                                             flow_timestep, DX);
+      }
+    }
+  }
+
+  // ...then the concentrations, as depth_update() does
+  #pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    for (int y = column_work.first(c); y <= column_work.last(c); y++)
+    {
+      int inc = 1;
+      while (down_scan[y][inc] > 0)
+      {
+        const unsigned x = down_scan[y][inc];
+        inc++;
+        Vsusptot[x][y] += flow_timestep * (qxs[x + 1][y] - qxs[x][y] + qys[x][y + 1] - qys[x][y]) / DX;
+      }
+    }
+  }
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// KERNEL SELECTION
+//
+// flow_route(), depth_update(), fused_hydro_step() and the entrainment
+// pass of erode() are templates over an option policy (see
+// LSDKernelOptions.hpp). The helpers below turn the run time options into
+// the matching instantiation, fixing one option at a time.
+//
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+typedef void (LSDCatchmentModel::*HydroKernelFn)();
+typedef double (LSDCatchmentModel::*ErosionKernelFn)(double);
+
+struct ErosionKernelSet
+{
+  HydroKernelFn rates;
+  ErosionKernelFn transfers;
+};
+
+template <class Options>
+static ErosionKernelSet erosion_kernels()
+{
+  ErosionKernelSet kernels = {
+    &LSDCatchmentModel::erosion_rates<Options>,
+    &LSDCatchmentModel::erosion_transfers<Options> };
+  return kernels;
+}
+
+struct HydroKernelSet
+{
+  HydroKernelFn flow_route;
+  HydroKernelFn depth_update;
+  HydroKernelFn fused_hydro_step;
+};
+
+template <class Options>
+static HydroKernelSet hydro_kernels()
+{
+  HydroKernelSet kernels = {
+    &LSDCatchmentModel::flow_route_impl<Options>,
+    &LSDCatchmentModel::depth_update_impl<Options>,
+    &LSDCatchmentModel::fused_hydro_step_impl<Options> };
+  return kernels;
+}
+
+template <bool SpatialMannings>
+static HydroKernelSet pick_hydro_suspended(const LSDRuntimeOptions& opts)
+{
+  return opts.suspended
+    ? hydro_kernels< LSDFlowOptions<SpatialMannings, true> >()
+    : hydro_kernels< LSDFlowOptions<SpatialMannings, false> >();
+}
+
+static HydroKernelSet pick_hydro_kernels(const LSDRuntimeOptions& opts)
+{
+  return opts.spatial_mannings ? pick_hydro_suspended<true>(opts)
+                               : pick_hydro_suspended<false>(opts);
+}
+
+template <int Fractions>
+static ErosionKernelSet pick_erosion_law(const LSDRuntimeOptions& opts)
+{
+  if (opts.wilcock)
+  {
+    return erosion_kernels< LSDErosionOptions<WILCOCK_LAW, Fractions> >();
+  }
+  if (opts.einstein)
+  {
+    return erosion_kernels< LSDErosionOptions<EINSTEIN_LAW, Fractions> >();
+  }
+  return erosion_kernels< LSDErosionOptions<NO_TRANSPORT_LAW, Fractions> >();
+}
+
+// The common numbers of grain size fractions get a kernel with the count
+// built in; any other count is read at run time (Fractions = 0)
+static ErosionKernelSet pick_erosion_kernel(const LSDRuntimeOptions& opts)
+{
+  switch (opts.fractions)
+  {
+    case 1: return pick_erosion_law<1>(opts);
+    case 3: return pick_erosion_law<3>(opts);
+    case 5: return pick_erosion_law<5>(opts);
+    case 9: return pick_erosion_law<9>(opts);
+    default: return pick_erosion_law<0>(opts);
+  }
+}
+
+void LSDCatchmentModel::select_kernels()
+{
+  runtime_options.spatial_mannings = spatially_var_mannings;
+  runtime_options.suspended = isSuspended[1];
+  runtime_options.wilcock = wilcock;
+  runtime_options.einstein = einstein;
+  runtime_options.vegetation = vegetation_on;
+  runtime_options.bedrock = bedrock_layer_on;
+  runtime_options.fractions = G_MAX - 1;
+
+  HydroKernelSet hydro = hydro_kernels<LSDRuntimeOptions>();
+  ErosionKernelSet erosion = erosion_kernels<LSDRuntimeOptions>();
+  if (specialised_kernels)
+  {
+    hydro = pick_hydro_kernels(runtime_options);
+    erosion = pick_erosion_kernel(runtime_options);
+  }
+  flow_route_kernel = hydro.flow_route;
+  depth_update_kernel = hydro.depth_update;
+  fused_hydro_step_kernel = hydro.fused_hydro_step;
+  erosion_rates_kernel = erosion.rates;
+  erosion_transfers_kernel = erosion.transfers;
+
+  std::cout << "Hydro and erosion kernels: "
+            << (specialised_kernels ? "specialised" : "generic")
+            << " (spatial mannings: " << runtime_options.spatial_mannings
+            << ", suspended: " << runtime_options.suspended
+            << ", wilcock: " << runtime_options.wilcock
+            << ", einstein: " << runtime_options.einstein
+            << ", vegetation: " << runtime_options.vegetation
+            << ", bedrock: " << runtime_options.bedrock
+            << ", grain size fractions: " << runtime_options.fractions << ")"
+            << std::endl;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// THE WATER ROUTING ALGORITHM: LISFLOOD-FP
+//
+// Originally derived in Bates et al (2010) Journal of Hydrology
+// The Lisflood-FP algorithm is a non steady state water flow
+// algorithm that uses a simplified version of the Saint-Venant
+// shallow water equations (see Hydrology textbooks) to calculate
+// water transport across the model.
+//
+// This algorithm was originally implemented in the CAESAR-Lisflood
+// model (2013), and remains broadly unchanged (except it's in C++)
+//
+//
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDCatchmentModel::flow_route()
+{
+  (this->*flow_route_kernel)();
+}
+
+template <class Options>
+void LSDCatchmentModel::flow_route_impl()
+{
+  const Options opts(runtime_options);
+  double flow_timestep = get_flow_timestep();
+  long long cells = 0;
+
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double kernel_start = omp_get_wtime();
+  #endif
+
+  if (row_major_traversal)
+  {
+    // Rows in the outer loop: consecutive cells of a thread are
+    // neighbours in memory. Each thread keeps its own hflow scratch rows
+    // for the vectorised kernels. The rows are shared out in the chunks
+    // of row_work (see LSDWorkPartition.hpp).
+    #pragma omp parallel reduction(+:cells)
+    {
+      std::vector<double> hflow_x(jmax + 2, 0.0);
+      std::vector<double> hflow_y(jmax + 2, 0.0);
+      #pragma omp for schedule(runtime)
+      for (int c = 0; c < row_work.chunks(); c++)
+      {
+        for (int x = row_work.first(c); x <= row_work.last(c); x++)
+        {
+          cells += route_row(x, flow_timestep, hflow_x, hflow_y, opts);
+        }
+      }
+    }
+  }
+  else
+  {
+    #pragma omp parallel for reduction(+:cells) schedule(runtime)
+    for (int c = 0; c < column_work.chunks(); c++)
+    {
+      for (int y = column_work.first(c); y <= column_work.last(c); y++)
+      {
+        int inc = 1;
+        while (down_scan[y][inc] > 0)
         {
-          double hflow = std::max(elev[x][y] + water_depth[x][y], elev[x][y - 1] + water_depth[x][y - 1]) -
-              std::max(elev[x][y], elev[x][y - 1]);
+          // This was a totally pointless idea but I leave it in to warn
+          // others of my folly... (DAV)
+    ////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]-1][y-1]);
+    ////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]-1][y]);
+    ////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]][y-1]);
+    ////      __builtin_prefetch(&water_depth[down_scan[y][inc+1]][y]);
+    ////      __builtin_prefetch(&elev[down_scan[y][inc+1]-1][y]);
+    ////      __builtin_prefetch(&elev[down_scan[y][inc+1]-1][y-1]);
+    ////      __builtin_prefetch(&elev[down_scan[y][inc+1]][y]);
+    ////      __builtin_prefetch(&elev[down_scan[y][inc+1]][y-1]);
+
+          route_cell_flow(down_scan[y][inc], y, flow_timestep, opts);
+          inc++;
+        }
+        cells += inc - 1;
+      }
+    }
+  }
 
-          if (hflow > hflow_threshold)
-          {
-            double tempslope = (((elev[x][y - 1] + water_depth[x][y - 1])) -
-                (elev[x][y] + water_depth[x][y])) / DX;
-            if (y == jmax) tempslope = edgeslope;
-            if (y <= 2 ) tempslope = 0 - edgeslope;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  hydro_kernel_seconds += omp_get_wtime() - kernel_start;
+  #endif
+  hydro_cells_processed += cells;
+}
+
+// The per-cell LISFLOOD update, shared by both traversal orders.
+// Writes only to the faces owned by cell (x,y) (and the vel_dir slots
+// pointing back into it), so the cells can be visited in any order.
+template <class Options>
+void LSDCatchmentModel::route_cell_flow(unsigned x, unsigned y,
+                                        double flow_timestep,
+                                        const Options& opts)
+{
+  if (elev[x][y] > -9999) // to stop moving water in to -9999's on elev
+  {
+    // SPATIAL MANNINGS
+    // (kept local to the cell: the member is shared by all threads)
+    double mannings = this->mannings;
+    if (opts.spatial_mannings)
+    {
+        mannings = spat_var_mannings[x][y];
+    }
+    route_face_x(x, y, flow_timestep, mannings, opts);
+    route_face_y(x, y, flow_timestep, mannings, opts);
+  }
+}
 
-            //double oldqy = qy[x][y];
-            qy[x][y] = ((qy[x][y] - (gravity * hflow * flow_timestep * tempslope)) /
-                        (1 + gravity * hflow * flow_timestep * (mannings * mannings) * std::abs(qy[x][y]) /
-                         std::pow(hflow, (10 / 3))));
-            //if (oldqy != 0) qy[x][y] = (oldqy + qy[x][y]) / 2;
+#ifndef LSD_SINGLE_PRECISION
+// Routes every wet cell of row x through the vectorised face kernels.
+// The wet list (cross_scan) is split into runs of consecutive columns, and
+// each run is handed to the kernel as one span. The few y faces on the
+// domain edge, where the slope is fixed, go through the scalar code.
+// Returns the number of cells routed.
+long long LSDCatchmentModel::route_row_vectorised(unsigned x,
+                                        double flow_timestep,
+                                        std::vector<double>& hflow_x,
+                                        std::vector<double>& hflow_y)
+{
+  const int* wet_cols = cross_scan.row(x);
 
-            // need to have these lines to stop too much water moving from one cellt o another - resulting in -ve discharges
-            // whihc causes a large instability to develop - only in steep catchments really
-            if (qy[x][y] > 0 && (qy[x][y] / hflow) / std::sqrt(gravity * hflow) > froude_limit ) qy[x][y] = hflow * (std::sqrt(gravity * hflow) * froude_limit );
-            if (qy[x][y] < 0 && std::abs(qy[x][y] / hflow) / std::sqrt(gravity * hflow) > froude_limit ) qy[x][y] = 0 - (hflow * (std::sqrt(gravity * hflow) * froude_limit));
+  LSDFaceParams params;
+  params.gravity = gravity;
+  params.flow_timestep = flow_timestep;
+  params.DX = DX;
+  params.mannings = mannings;
+  params.hflow_threshold = hflow_threshold;
+  params.froude_limit = froude_limit;
+  params.suspended = isSuspended[1];
+
+  // Fixed slopes on the x faces of the edge rows, as in route_face_x()
+  LSDFaceParams x_params = params;
+  x_params.fixed_slope = false;
+  x_params.slope = 0;
+  if (x == imax)
+  {
+    x_params.fixed_slope = true;
+    x_params.slope = edgeslope;
+  }
+  if (x <= 2)
+  {
+    x_params.fixed_slope = true;
+    x_params.slope = 0 - edgeslope;
+  }
+  LSDFaceParams y_params = params;
+  y_params.fixed_slope = false;
+  y_params.slope = 0;
 
-            if (qy[x][y] > 0 && (qy[x][y] * flow_timestep / DX) > (water_depth[x][y] / 4)) qy[x][y] = ((water_depth[x][y] * DX) / 5) / flow_timestep;
-            if (qy[x][y] < 0 && std::abs(qy[x][y] * flow_timestep / DX) > (water_depth[x][y - 1] / 4)) qy[x][y] = 0 - ((water_depth[x][y - 1] * DX) / 5) / flow_timestep;
+  int inc = 1;
+  while (wet_cols[inc] > 0)
+  {
+    const int y_start = wet_cols[inc];
+    int y_end = y_start;
+    while (wet_cols[inc + 1] == y_end + 1)
+    {
+      inc++;
+      y_end++;
+    }
+    inc++;
 
+    // x faces of the whole run
+    LSDFaceSpan span;
+    span.elev = elev.row(x) + y_start;
+    span.depth = water_depth.row(x) + y_start;
+    span.susp = Vsusptot.row(x) + y_start;
+    span.elev_nb = elev.row(x - 1) + y_start;
+    span.depth_nb = water_depth.row(x - 1) + y_start;
+    span.susp_nb = Vsusptot.row(x - 1) + y_start;
+    span.mannings = spatially_var_mannings ?
+                    spat_var_mannings.row(x) + y_start : NULL;
+    span.q = qx.row(x) + y_start;
+    span.qs = qxs.row(x) + y_start;
+    span.hflow_out = &hflow_x[y_start];
+    span.count = y_end - y_start + 1;
+    face_kernel(span, x_params);
+
+    // y faces: the interior part of the run, 3 <= y < jmax
+    const int y_lo = std::max(y_start, 3);
+    const int y_hi = std::min(y_end, static_cast<int>(jmax) - 1);
+    for (int y = y_start; y <= y_end; y++)
+    {
+      if ((y < y_lo || y > y_hi) && elev[x][y] > -9999)
+      {
+        double cell_n = spatially_var_mannings ? spat_var_mannings[x][y]
+                                               : mannings;
+        route_face_y(x, y, flow_timestep, cell_n, runtime_options);
+      }
+      hflow_y[y] = 0;
+    }
+    if (y_hi >= y_lo)
+    {
+      span.elev = elev.row(x) + y_lo;
+      span.depth = water_depth.row(x) + y_lo;
+      span.susp = Vsusptot.row(x) + y_lo;
+      span.elev_nb = elev.row(x) + y_lo - 1;
+      span.depth_nb = water_depth.row(x) + y_lo - 1;
+      span.susp_nb = Vsusptot.row(x) + y_lo - 1;
+      span.mannings = spatially_var_mannings ?
+                      spat_var_mannings.row(x) + y_lo : NULL;
+      span.q = qy.row(x) + y_lo;
+      span.qs = qys.row(x) + y_lo;
+      span.hflow_out = &hflow_y[y_lo];
+      span.count = y_hi - y_lo + 1;
+      face_kernel(span, y_params);
+    }
 
-            if (isSuspended[1])
-            {
+    // Face velocities, from the faces that carried flow
+    for (int y = y_start; y <= y_end; y++)
+    {
+      if (hflow_x[y] > 0)
+      {
+        if (qx[x][y] > 0) vel_dir[x][y][7] = qx[x][y] / hflow_x[y];
+        if (qx[x][y] < 0) vel_dir[x - 1][y][3] = (0 - qx[x][y]) / hflow_x[y];
+      }
+      if (hflow_y[y] > 0)
+      {
+        if (qy[x][y] > 0) vel_dir[x][y][1] = qy[x][y] / hflow_y[y];
+        if (qy[x][y] < 0) vel_dir[x][y - 1][5] = (0 - qy[x][y]) / hflow_y[y];
+      }
+    }
+  }
+  return inc - 1;
+}
+#endif
 
-              if (qy[x][y] > 0) qys[x][y] = qy[x][y] * (Vsusptot[x][y] / water_depth[x][y]);
-              if (qy[x][y] < 0) qys[x][y] = qy[x][y] * (Vsusptot[x][y - 1] / water_depth[x][y - 1]);
+template <class Options>
+long long LSDCatchmentModel::route_row(unsigned x, double flow_timestep,
+                                       std::vector<double>& hflow_x,
+                                       std::vector<double>& hflow_y,
+                                       const Options& opts)
+{
+  #ifndef LSD_SINGLE_PRECISION
+  if (face_kernel != NULL)
+  {
+    return route_row_vectorised(x, flow_timestep, hflow_x, hflow_y);
+  }
+  #endif
+  int inc = 1;
+  while (cross_scan[x][inc] > 0)
+  {
+    route_cell_flow(x, cross_scan[x][inc], flow_timestep, opts);
+    inc++;
+  }
+  return inc - 1;
+}
 
-              if (qys[x][y] > 0 && qys[x][y] * flow_timestep > (Vsusptot[x][y] * DX) / 4) qys[x][y] = ((Vsusptot[x][y] * DX) / 5) / flow_timestep;
-              if (qys[x][y] < 0 && std::abs(qys[x][y] * flow_timestep) > (Vsusptot[x][y - 1] * DX) / 4) qys[x][y] = 0 - ((Vsusptot[x][y - 1] * DX) / 5) / flow_timestep;
+// The x face (between x-1 and x) of cell (x,y). The caller has checked
+// that (x,y) itself is not nodata.
+template <class Options>
+void LSDCatchmentModel::route_face_x(unsigned x, unsigned y,
+                                     double flow_timestep, double mannings,
+                                     const Options& opts)
+{
+  // routing in x direction
+  if ((water_depth[x][y] > 0 || water_depth[x - 1][y] > 0) \
+    && elev[x - 1][y] > -9999)
+    // need to check water and not -9999 on elev?
+  {
+    double hflow = std::max(elev[x][y] + water_depth[x][y],
+                            elev[x - 1][y] + water_depth[x - 1][y]) \
+                            - std::max(elev[x - 1][y], elev[x][y]);
+
+    if (hflow > hflow_threshold)
+    {
+      double tempslope = (((elev[x - 1][y] + water_depth[x - 1][y])) -
+          (elev[x][y] + water_depth[x][y])) / DX;
+
+      if (x == imax) tempslope = edgeslope;
+      if (x <= 2) tempslope = 0 - edgeslope;
+
+      //double oldqx = qx[x][y];
+      qx[x][y] = ((qx[x][y] - (gravity * hflow \
+                    * flow_timestep * tempslope)) \
+                    / (1 + gravity * hflow * flow_timestep \
+                    * (mannings * mannings) * std::abs(qx[x][y]) \
+                    / (hflow * hflow * hflow)));
+      //if (oldqx != 0) qx[x][y] = (oldqx + qx[x][y]) / 2;
+
+      // need to have these lines to stop too much water moving from
+      // one cell to another - resulting in negative discharges
+      // which causes a large instability to develop
+      // - only in steep catchments really
+
+      // FROUDE NUBER CHECKS
+      if (qx[x][y] > 0 && (qx[x][y]
+          / hflow) / std::sqrt(gravity * hflow) > froude_limit )
+      {
+        qx[x][y] = hflow * (std::sqrt(gravity*hflow) * froude_limit );
+      }
+      // If the discahrge is now negative and above the froude_limit...
+      if (qx[x][y] < 0 && std::abs(qx[x][y] / hflow)
+          / std::sqrt(gravity * hflow) > froude_limit )
+      {
+        qx[x][y] = 0 - (hflow * (std::sqrt(gravity * hflow) * froude_limit ));
+      }
 
-            }
+      // DISCHARGE MAGNITUDE/TIMESTEP CHECKS
+      // If the discharge is too high for this timestep, scale back...
+      if (qx[x][y] > 0 && (qx[x][y] * flow_timestep / DX)
+          > (water_depth[x][y] / 4))
+      {
+        qx[x][y] = ((water_depth[x][y] * DX) / 5) / flow_timestep;
+      }
+      // If the discharge is negative and too large, scale back...
+      if (qx[x][y] < 0 && std::abs(qx[x][y] * flow_timestep / DX)
+        > (water_depth[x - 1][y] / 4))
+      {
+        qx[x][y] = 0 - ((water_depth[x - 1][y] * DX) / 5) / flow_timestep;
+      }
 
-            // calc velocity now
-            if (qy[x][y] > 0) vel_dir[x][y][1] = qy[x][y] / hflow;
-            if (qy[x][y] < 0) vel_dir[x][y - 1][5] = (0 - qy[x][y]) / hflow;
-          }
-          else
-          {
-            qy[x][y] = 0;
-            qys[x][y] = 0;
-          }
+      // Update suspended fraction discharges
+      if (opts.suspended)
+      {
+        if (qx[x][y] > 0)
+        {
+          qxs[x][y] = qx[x][y] * (Vsusptot[x][y] / water_depth[x][y]);
+        }
+        if (qx[x][y] < 0)
+        {
+          qxs[x][y] = qx[x][y] \
+            * (Vsusptot[x - 1][y] / water_depth[x - 1][y]);
         }
 
+        if (qxs[x][y] > 0 && qxs[x][y] * flow_timestep
+          > (Vsusptot[x][y] * DX) / 4)
+        {
+          qxs[x][y] = ((Vsusptot[x][y] * DX) / 5) / flow_timestep;
+        }
+
+        if (qxs[x][y] < 0 && std::abs(qxs[x][y] * flow_timestep)
+          > (Vsusptot[x - 1][y] * DX) / 4)
+        {
+          qxs[x][y] = 0 - ((Vsusptot[x - 1][y] * DX) / 5) / flow_timestep;
+        }
       }
+
+      // calc velocity now
+      if (qx[x][y] > 0)
+      {
+        vel_dir[x][y][7] = qx[x][y] / hflow;
+      }
+      if (qx[x][y] < 0)
+      {
+        vel_dir[x - 1][y][3] = (0- qx[x][y]) / hflow;
+      }
+
+    }
+    else
+    {
+      qx[x][y] = 0;
+      qxs[x][y] = 0;
+    }
+  }
+}
+
+// The y face (between y-1 and y) of cell (x,y).
+template <class Options>
+void LSDCatchmentModel::route_face_y(unsigned x, unsigned y,
+                                     double flow_timestep, double mannings,
+                                     const Options& opts)
+{
+  //routing in the y direction
+  if ((water_depth[x][y] > 0 || water_depth[x][y - 1] > 0) && elev[x][y - 1] > -9999)
+  {
+    double hflow = std::max(elev[x][y] + water_depth[x][y], elev[x][y - 1] + water_depth[x][y - 1]) -
+        std::max(elev[x][y], elev[x][y - 1]);
+
+    if (hflow > hflow_threshold)
+    {
+      double tempslope = (((elev[x][y - 1] + water_depth[x][y - 1])) -
+          (elev[x][y] + water_depth[x][y])) / DX;
+      if (y == jmax) tempslope = edgeslope;
+      if (y <= 2 ) tempslope = 0 - edgeslope;
+
+      //double oldqy = qy[x][y];
+      qy[x][y] = ((qy[x][y] - (gravity * hflow * flow_timestep * tempslope)) /
+                  (1 + gravity * hflow * flow_timestep * (mannings * mannings) * std::abs(qy[x][y]) /
+                   (hflow * hflow * hflow)));
+      //if (oldqy != 0) qy[x][y] = (oldqy + qy[x][y]) / 2;
+
+      // need to have these lines to stop too much water moving from one cellt o another - resulting in -ve discharges
+      // whihc causes a large instability to develop - only in steep catchments really
+      if (qy[x][y] > 0 && (qy[x][y] / hflow) / std::sqrt(gravity * hflow) > froude_limit ) qy[x][y] = hflow * (std::sqrt(gravity * hflow) * froude_limit );
+      if (qy[x][y] < 0 && std::abs(qy[x][y] / hflow) / std::sqrt(gravity * hflow) > froude_limit ) qy[x][y] = 0 - (hflow * (std::sqrt(gravity * hflow) * froude_limit));
+
+      if (qy[x][y] > 0 && (qy[x][y] * flow_timestep / DX) > (water_depth[x][y] / 4)) qy[x][y] = ((water_depth[x][y] * DX) / 5) / flow_timestep;
+      if (qy[x][y] < 0 && std::abs(qy[x][y] * flow_timestep / DX) > (water_depth[x][y - 1] / 4)) qy[x][y] = 0 - ((water_depth[x][y - 1] * DX) / 5) / flow_timestep;
+
+
+      if (opts.suspended)
+      {
+
+        if (qy[x][y] > 0) qys[x][y] = qy[x][y] * (Vsusptot[x][y] / water_depth[x][y]);
+        if (qy[x][y] < 0) qys[x][y] = qy[x][y] * (Vsusptot[x][y - 1] / water_depth[x][y - 1]);
+
+        if (qys[x][y] > 0 && qys[x][y] * flow_timestep > (Vsusptot[x][y] * DX) / 4) qys[x][y] = ((Vsusptot[x][y] * DX) / 5) / flow_timestep;
+        if (qys[x][y] < 0 && std::abs(qys[x][y] * flow_timestep) > (Vsusptot[x][y - 1] * DX) / 4) qys[x][y] = 0 - ((Vsusptot[x][y - 1] * DX) / 5) / flow_timestep;
+
+      }
+
+      // calc velocity now
+      if (qy[x][y] > 0) vel_dir[x][y][1] = qy[x][y] / hflow;
+      if (qy[x][y] < 0) vel_dir[x][y - 1][5] = (0 - qy[x][y]) / hflow;
+    }
+    else
+    {
+      qy[x][y] = 0;
+      qys[x][y] = 0;
     }
   }
 }
@@ -3258,46 +4256,259 @@ void LSDCatchmentModel::flow_route()
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDCatchmentModel::depth_update()
 {
+  (this->*depth_update_kernel)();
+}
+
+template <class Options>
+void LSDCatchmentModel::depth_update_impl()
+{
+  const Options opts(runtime_options);
   double flow_timestep = get_flow_timestep();
 
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double kernel_start = omp_get_wtime();
+  #endif
+
   maxdepth = 0;
   double l_maxdepth = maxdepth;
-  #pragma omp parallel for reduction(max:l_maxdepth)
-  for (unsigned y = 1; y<= jmax; y++)
+  if (row_major_traversal)
   {
-    int inc = 1;
-    double tempmaxdepth = 0;
-    while (down_scan[y][inc] > 0)
+    #pragma omp parallel for reduction(max:l_maxdepth) schedule(runtime)
+    for (int c = 0; c < row_work.chunks(); c++)
     {
-      unsigned x = down_scan[y][inc];
-      inc++;
+      for (int x = row_work.first(c); x <= row_work.last(c); x++)
+      {
+        double tempmaxdepth = update_row_depth(x, flow_timestep, opts);
+        if (tempmaxdepth > l_maxdepth)
+        {
+          l_maxdepth = tempmaxdepth;
+        }
+      }
+    }
+  }
+  else
+  {
+    #pragma omp parallel for reduction(max:l_maxdepth) schedule(runtime)
+    for (int c = 0; c < column_work.chunks(); c++)
+    {
+      for (int y = column_work.first(c); y <= column_work.last(c); y++)
+      {
+        int inc = 1;
+        double tempmaxdepth = 0;
+        while (down_scan[y][inc] > 0)
+        {
+          double depth = update_cell_depth(down_scan[y][inc], y,
+                                           flow_timestep, opts);
+          if (depth > tempmaxdepth) tempmaxdepth = depth;
+          inc++;
+        }
+        if (tempmaxdepth > l_maxdepth)
+        {
+          l_maxdepth = tempmaxdepth;
+        }
+      }
+    }
+  }
+  maxdepth = l_maxdepth;
+  // reduction for later parallelism implementation DAV
+  //for (unsigned x = 1; y <= jmax; y++) if (tempmaxdepth2[y] > maxdepth) maxdepth = tempmaxdepth2[y];
+
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  hydro_kernel_seconds += omp_get_wtime() - kernel_start;
+  #endif
+}
+
+template <class Options>
+double LSDCatchmentModel::update_row_depth(unsigned x, double flow_timestep,
+                                           const Options& opts)
+{
+  // Whole rows of the grids are contiguous, so fetch the row pointers
+  // once and let the compiler assume they do not alias.
+  hydro_real* LSD_RESTRICT depth_row = water_depth.row(x);
+  double* LSD_RESTRICT susp_row = Vsusptot.row(x);
+  const double* LSD_RESTRICT elev_row = elev.row(x);
+  const hydro_real* LSD_RESTRICT qx_row = qx.row(x);
+  const hydro_real* LSD_RESTRICT qx_below = qx.row(x + 1);
+  const hydro_real* LSD_RESTRICT qy_row = qy.row(x);
+  const double* LSD_RESTRICT qxs_row = qxs.row(x);
+  const double* LSD_RESTRICT qxs_below = qxs.row(x + 1);
+  const double* LSD_RESTRICT qys_row = qys.row(x);
+  const int* LSD_RESTRICT wet_cols = cross_scan.row(x);
+
+  int inc = 1;
+  double tempmaxdepth = 0;
+  while (wet_cols[inc] > 0)
+  {
+    const int y = wet_cols[inc];
+    depth_row[y] += flow_timestep * (qx_below[y] - qx_row[y]
+                                     + qy_row[y + 1] - qy_row[y]) / DX;
+    if (opts.suspended)
+    {
+      susp_row[y] += flow_timestep * (qxs_below[y] - qxs_row[y]
+                                      + qys_row[y + 1] - qys_row[y]) / DX;
+    }
+    if (depth_row[y] > 0)
+    {
+      if (elev_row[y] == -9999) depth_row[y] = 0;
+      if (depth_row[y] > tempmaxdepth) tempmaxdepth = depth_row[y];
+    }
+    inc++;
+  }
+  return tempmaxdepth;
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// FUSED HYDRO STEP
+//
+// flow_route(), depth_update() and the edge outflow in one pass, band
+// by band (see the header). Only used with row-major traversal.
+//
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDCatchmentModel::fused_hydro_step()
+{
+  (this->*fused_hydro_step_kernel)();
+}
+
+template <class Options>
+void LSDCatchmentModel::fused_hydro_step_impl()
+{
+  const Options opts(runtime_options);
+  double flow_timestep = get_flow_timestep();
+  long long cells = 0;
+  double l_maxdepth = 0;
+
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double kernel_start = omp_get_wtime();
+  #endif
+
+  // Draining the edges straight after the depth update is only the same
+  // as water_flux_out() if nothing in between looks at the edge depths:
+  // erosion does, and a zero threshold would dry the edge cells out
+  // before the wet area scan.
+  const bool drain = hydro_only && water_depth_erosion_threshold > 0;
+  const int bands = tiles.tiles_x();
+
+  #pragma omp parallel reduction(+:cells) reduction(max:l_maxdepth)
+  {
+    std::vector<double> hflow_x(jmax + 2, 0.0);
+    std::vector<double> hflow_y(jmax + 2, 0.0);
 
-      // update water depths
-      water_depth[x][y] += flow_timestep * (qx[x + 1][y] - qx[x][y] + qy[x][y + 1] - qy[x][y]) / DX;
-      // now update SS concs
-      if (isSuspended[1])
+    // The halo rows: the x faces of the first row of a band read the
+    // depths of the last row of the band above.
+    #pragma omp for
+    for (int band = 0; band < bands; band++)
+    {
+      cells += route_row(tiles.first_row(band), flow_timestep,
+                         hflow_x, hflow_y, opts);
+    }
+
+    #pragma omp for
+    for (int band = 0; band < bands; band++)
+    {
+      const int last = tiles.last_row(band);
+      for (int x = tiles.first_row(band); x <= last; x++)
       {
-        Vsusptot[x][y] += flow_timestep * (qxs[x + 1][y] - qxs[x][y] + qys[x][y + 1] - qys[x][y]) / DX;
+        if (x < last)
+        {
+          cells += route_row(x + 1, flow_timestep, hflow_x, hflow_y, opts);
+        }
+        double tempmaxdepth = update_row_depth(x, flow_timestep, opts);
+        if (tempmaxdepth > l_maxdepth)
+        {
+          l_maxdepth = tempmaxdepth;
+        }
+        if (drain) drain_row_edges(x);
       }
+    }
+  }
+  maxdepth = l_maxdepth;
 
-      if (water_depth[x][y] > 0)
+  if (drain)
+  {
+    // Summed in the same order as water_flux_out()
+    temptot = 0;
+    for (unsigned i = 1; i <= imax; i++)
+    {
+      temptot += edge_outflow_right[i];
+      temptot += edge_outflow_left[i];
+    }
+    for (unsigned j = 1; j <= jmax; j++)
+    {
+      temptot += edge_outflow_top[j];
+      temptot += edge_outflow_bottom[j];
+    }
+    waterOut = temptot;
+    edges_drained = true;
+  }
+
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  hydro_kernel_seconds += omp_get_wtime() - kernel_start;
+  #endif
+  hydro_cells_processed += cells;
+}
+
+void LSDCatchmentModel::drain_row_edges(unsigned x)
+{
+  const double flow_timestep = time_step;
+  edge_outflow_right[x] = 0;
+  edge_outflow_left[x] = 0;
+  // RH Edge
+  if (water_depth[x][jmax] > water_depth_erosion_threshold)
+  {
+    edge_outflow_right[x] = (water_depth[x][jmax] - water_depth_erosion_threshold) \
+      * DX * DX / flow_timestep;
+    water_depth[x][jmax] = water_depth_erosion_threshold;
+  }
+  // LH Edge
+  if (water_depth[x][1] > water_depth_erosion_threshold)
+  {
+    edge_outflow_left[x] = (water_depth[x][1] - water_depth_erosion_threshold) \
+      * DX * DX / flow_timestep;
+    water_depth[x][1] = water_depth_erosion_threshold;
+  }
+
+  // Top and bottom edges, after the corners have been drained above
+  if (x == 1 || x == imax)
+  {
+    std::vector<double>& outflow = (x == 1) ? edge_outflow_top
+                                            : edge_outflow_bottom;
+    for (unsigned j = 1; j <= jmax; j++)
+    {
+      outflow[j] = 0;
+      if (water_depth[x][j] > water_depth_erosion_threshold)
       {
-        // line to remove any water depth on nodata cells (that shouldnt get there!)
-        if (elev[x][y] == -9999) water_depth[x][y] = 0;
-        // calc max flow depth for time step calc
-        if (water_depth[x][y] > tempmaxdepth) tempmaxdepth = water_depth[x][y];
+        outflow[j] = (water_depth[x][j] - water_depth_erosion_threshold) \
+          * DX * DX / flow_timestep;
+        water_depth[x][j] = water_depth_erosion_threshold;
       }
     }
-    if (tempmaxdepth > l_maxdepth)
-    {
-      l_maxdepth = tempmaxdepth;
-    }
   }
-  maxdepth = l_maxdepth;
-  // reduction for later parallelism implementation DAV
-  //for (unsigned x = 1; y <= jmax; y++) if (tempmaxdepth2[y] > maxdepth) maxdepth = tempmaxdepth2[y];
 }
 
+template <class Options>
+double LSDCatchmentModel::update_cell_depth(unsigned x, unsigned y,
+                                            double flow_timestep,
+                                            const Options& opts)
+{
+  // update water depths
+  water_depth[x][y] += flow_timestep * (qx[x + 1][y] - qx[x][y] + qy[x][y + 1] - qy[x][y]) / DX;
+  // now update SS concs
+  if (opts.suspended)
+  {
+    Vsusptot[x][y] += flow_timestep * (qxs[x + 1][y] - qxs[x][y] + qys[x][y + 1] - qys[x][y]) / DX;
+  }
+
+  if (water_depth[x][y] > 0)
+  {
+    // line to remove any water depth on nodata cells (that shouldnt get there!)
+    if (elev[x][y] == -9999) water_depth[x][y] = 0;
+    // calc max flow depth for time step calc
+    return water_depth[x][y];
+  }
+  return 0;
+}
+
+
 void LSDCatchmentModel::reach_water_and_sediment_input()
 {
   double flow_timestep = get_flow_timestep();
@@ -3342,6 +4553,7 @@ void LSDCatchmentModel::reach_water_and_sediment_input()
           {
             grain[index[x][y]][tempn - 4] += amount_to_add;
             elev[x][y] += amount_to_add;
+            note_height_change(x, y);
           }
         }
       }
@@ -3408,6 +4620,7 @@ void LSDCatchmentModel::reach_water_and_sediment_input()
   #ifdef DEBUG_LVL_3
   std::cout << "number of points, : " << number_of_points << std::endl;
   #endif
+  reach_inflow = 0;
   for (int n = 0; n <= number_of_points - 1; n++)
   {
     #ifdef DEBUG_LVL_3
@@ -3433,13 +4646,19 @@ void LSDCatchmentModel::reach_water_and_sediment_input()
     //j_mean = old_j_mean + (((new_j_mean - old_j_mean) / 2) * (2 - time));
     
     waterinput += (input / div_inputs);
+    reach_inflow += (input / div_inputs);
 
     #ifdef DEBUG
     //std::cout << "waterinput is: " << waterinput << std::endl;
     #endif
     // trial adding SS line
     // if(counter<500)Vsusptot[x+5, y] = 0.1;
-    water_depth[x][y] += (input / div_inputs) / (DX * DX) * flow_timestep;
+    // (a frozen flow field already carries it)
+    if (!quasi_steady_frozen)
+    {
+      water_depth[x][y] += (input / div_inputs) / (DX * DX) * flow_timestep;
+      note_water_added(x, y);
+    }
     #ifdef DEBUG_LVL_3
     if (water_depth[x][y] > 0.0)
     {
@@ -3473,7 +4692,10 @@ void LSDCatchmentModel::catchment_water_input_and_hydrology( double flow_timeste
 
     // Removed now as done above
     // waterinput += (water_add_amt / flow_timestep) * DX * DX;
+    // (a frozen flow field already carries it)
+    if (quasi_steady_frozen) continue;
     water_depth[i][j] += water_add_amt;
+    note_water_added(i, j);
   }
   // if the input type flag is 1 then the discharge is input from the hydrograph
   if (cycle >= time_1)
@@ -3544,11 +4766,17 @@ void LSDCatchmentModel::catchment_water_input_and_hydrology( double flow_timeste
 void LSDCatchmentModel::catchment_water_input_and_hydrology( double flow_timestep,
                                                                  runoffGrid& runoff)
 {
+  // There is no runoff in the no data cells, so tiles without data are
+  // skipped.
   for (unsigned i = 1; i<imax; i++)
   {
-    for (unsigned j =1; j<jmax; j++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(i))
     {
-      waterinput += runoff.get_j_mean(i,j) * DX * DX;
+      unsigned j_end = std::min(span.last, static_cast<int>(jmax) - 1);
+      for (unsigned j = span.first; j <= j_end; j++)
+      {
+        waterinput += runoff.get_j_mean(i,j) * DX * DX;
+      }
     }
   }
 
@@ -3558,18 +4786,25 @@ void LSDCatchmentModel::catchment_water_input_and_hydrology( double flow_timeste
   //#pragma omp parallel for reduction(+:waterinput)
   for (unsigned i=1; i<imax; i++)
   {
-    for (unsigned j=1; j<jmax; j++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(i))
     {
-      double water_add_amt = runoff.get_j_mean(i,j) * flow_timestep;    //
-
-      if (water_add_amt > ERODEFACTOR)
+      unsigned j_end = std::min(span.last, static_cast<int>(jmax) - 1);
+      for (unsigned j = span.first; j <= j_end; j++)
       {
-        water_add_amt = ERODEFACTOR;
-      }
+        double water_add_amt = runoff.get_j_mean(i,j) * flow_timestep;    //
+
+        if (water_add_amt > ERODEFACTOR)
+        {
+          water_add_amt = ERODEFACTOR;
+        }
 
-      waterinput += (water_add_amt / flow_timestep) * DX * DX;
+        waterinput += (water_add_amt / flow_timestep) * DX * DX;
 
-      water_depth[i][j] += water_add_amt;
+        // (a frozen flow field already carries it)
+        if (quasi_steady_frozen) continue;
+        water_depth[i][j] += water_add_amt;
+        if (water_add_amt > 0) note_water_added(i, j);
+      }
     }
   }
 
@@ -3577,11 +4812,14 @@ void LSDCatchmentModel::catchment_water_input_and_hydrology( double flow_timeste
   double new_jmeanmax = 0;
   for (unsigned m=1; m <= imax; m++)
   {
-    for (unsigned n=1; n<=jmax; n++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(m))
     {
-      if (runoff.get_new_j_mean(m,n) > new_jmeanmax)
+      for (int n = span.first; n <= span.last; n++)
       {
-        new_jmeanmax = runoff.get_new_j_mean(m,n);
+        if (runoff.get_new_j_mean(m,n) > new_jmeanmax)
+        {
+          new_jmeanmax = runoff.get_new_j_mean(m,n);
+        }
       }
     }
   }
@@ -3727,13 +4965,17 @@ void LSDCatchmentModel::calchydrograph(double time)
 // rainfall inputs.
 void LSDCatchmentModel::calchydrograph(double time, runoffGrid& runoff)
 {
+  // j_mean stays at zero in the no data cells
   for (unsigned m=1; m<= imax; m++)
   {
-    for (unsigned n=1; n <= jmax; n++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(m))
     {
-      double cell_j_mean = runoff.get_old_j_mean(m,n) + (( (runoff.get_new_j_mean(m,n) - runoff.get_old_j_mean(m,n)) / 2) * (2 - time));
-      // set the calculated j_mean value for the current cell in the loop
-      runoff.set_j_mean(m, n, cell_j_mean);
+      for (int n = span.first; n <= span.last; n++)
+      {
+        double cell_j_mean = runoff.get_old_j_mean(m,n) + (( (runoff.get_new_j_mean(m,n) - runoff.get_old_j_mean(m,n)) / 2) * (2 - time));
+        // set the calculated j_mean value for the current cell in the loop
+        runoff.set_j_mean(m, n, cell_j_mean);
+      }
     }
   }
 }
@@ -3815,39 +5057,532 @@ void LSDCatchmentModel::evaporate(double time)
         if (water_depth[x][y] < 0) water_depth[x][y] = 0;
       }
     }
-  }//);
-}
+  }//);
+}
+
+void LSDCatchmentModel::scan_area()
+{
+  if (row_major_traversal)
+  {
+    scan_area_row_major();
+    // The erosion and landsliding routines still walk down_scan
+    if (hydro_only) return;
+  }
+
+  #pragma omp parallel for
+  for (unsigned j=1; j <= jmax; j++)
+  {
+    int inc = 1;
+    for (unsigned i=1; i <= imax; i++)
+    {
+      // zero scan bit..
+      down_scan[j][i] = 0;
+      // and work out scanned area. // TO DO (DAV) there is some out-of-bounds indexing going on here, check carefully!
+      if (water_depth[i][j] > 0
+          || water_depth[i][j - 1] > 0
+          || water_depth[i][j + 1] > 0
+          || water_depth[i - 1][j] > 0
+          || water_depth[i - 1][j - 1] > 0
+          || water_depth[i - 1][j + 1] > 0
+          || water_depth[i + 1][j - 1] > 0
+          || water_depth[i + 1][j + 1] > 0
+          || water_depth[i + 1][j] > 0
+          )
+      {
+        down_scan[j][inc] = i;
+        inc++;
+        // inc will increment everytime there is water found in a cell
+      }
+    }
+  }
+}
+
+void LSDCatchmentModel::scan_area_row_major()
+{
+  #pragma omp parallel for
+  for (unsigned i=1; i <= imax; i++)
+  {
+    int inc = 1;
+    for (unsigned j=1; j <= jmax; j++)
+    {
+      cross_scan[i][j] = 0;
+      if (water_depth[i][j] > 0
+          || water_depth[i][j - 1] > 0
+          || water_depth[i][j + 1] > 0
+          || water_depth[i - 1][j] > 0
+          || water_depth[i - 1][j - 1] > 0
+          || water_depth[i - 1][j + 1] > 0
+          || water_depth[i + 1][j - 1] > 0
+          || water_depth[i + 1][j + 1] > 0
+          || water_depth[i + 1][j] > 0
+          )
+      {
+        cross_scan[i][inc] = j;
+        inc++;
+      }
+    }
+  }
+}
+
+
+void LSDCatchmentModel::refresh_tile_wet_state()
+{
+  // Every cell that can get wet before the next check is on the wet
+  // lists, or is an input cell and gets flagged by note_water_added().
+  // Each thread works on whole tile columns (or rows), so no two threads
+  // write to the same tile.
+  tiles.clear_wet();
+  if (!row_major_traversal || !hydro_only)
+  {
+    #pragma omp parallel for
+    for (int ty = 0; ty < tiles.tiles_y(); ty++)
+    {
+      for (int y = tiles.first_col(ty); y <= tiles.last_col(ty); y++)
+      {
+        for (int inc = 1; down_scan[y][inc] > 0; inc++)
+        {
+          int x = down_scan[y][inc];
+          tiles.note_depth(x, y, water_depth[x][y]);
+        }
+      }
+    }
+  }
+  else
+  {
+    #pragma omp parallel for
+    for (int tx = 0; tx < tiles.tiles_x(); tx++)
+    {
+      for (int x = tiles.first_row(tx); x <= tiles.last_row(tx); x++)
+      {
+        for (int inc = 1; cross_scan[x][inc] > 0; inc++)
+        {
+          int y = cross_scan[x][inc];
+          tiles.note_depth(x, y, water_depth[x][y]);
+        }
+      }
+    }
+  }
+}
+
+void LSDCatchmentModel::rebuild_work_partitions()
+{
+  if (work_schedule == STATIC_SCHEDULE) return;
+  int threads = 1;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  threads = omp_get_max_threads();
+  #endif
+
+  // down_scan is not kept in row-major hydro only runs (see
+  // refresh_tile_wet_state()), and nothing walks it there either.
+  if (!row_major_traversal || !hydro_only)
+  {
+    std::vector<int> wet_cells(jmax + 1, 0);
+    for (unsigned y = 1; y <= jmax; y++)
+    {
+      int inc = 1;
+      while (down_scan[y][inc] > 0) inc++;
+      wet_cells[y] = inc - 1;
+    }
+    column_work.rebuild(wet_cells, threads);
+  }
+  if (row_major_traversal)
+  {
+    std::vector<int> wet_cells(imax + 1, 0);
+    for (unsigned x = 1; x <= imax; x++)
+    {
+      int inc = 1;
+      while (cross_scan[x][inc] > 0) inc++;
+      wet_cells[x] = inc - 1;
+    }
+    row_work.rebuild(wet_cells, threads);
+  }
+}
+
+// Moves the model arrays onto the memory nodes of the threads that use
+// them. Every array is copied into a fresh buffer inside a parallel
+// region, thread t writing the lines of chunk t of the static split (and
+// the halo beyond the end lines, for the first and last thread). With
+// numa_first_touch off the arrays are only listed, for the report.
+//
+// The rows are the contiguous dimension, so a thread's columns of a row
+// only fill pages of their own if they come to at least a page. On
+// narrower grids each page would be first touched by several threads and
+// land anywhere, so the arrays placed by columns are placed by blocks of
+// whole rows instead.
+class ArrayPlacer
+{
+public:
+  ArrayPlacer(bool first_touch_in) : first_touch(first_touch_in) {}
+
+  /// Places grid by rows (lines along dim1) or columns (along dim2).
+  template <class T>
+  void grid(const std::string& name, LSDGrid<T>& grid, bool by_rows)
+  {
+    if (grid.dim1() == 0) return;
+    if (!by_rows) by_rows = !fills_pages(grid.dim2() - 2, sizeof(T));
+    if (first_touch)
+    {
+      const int lines = (by_rows ? grid.dim1() : grid.dim2()) - 2;
+      const int halo = grid.halo();
+      LSDGrid<T> placed = LSDGrid<T>::unfilled_like(grid);
+      #pragma omp parallel
+      {
+        int first, last;
+        if (my_lines(lines, first, last))
+        {
+          if (first == 1) first = -halo;
+          if (last == lines) last = lines + 1 + halo;
+          if (by_rows) placed.copy_rows(grid, first, last);
+          else placed.copy_columns(grid, first, last);
+        }
+      }
+      grid = std::move(placed);
+    }
+    add(name, by_rows, grid.data(), grid.bytes());
+  }
+
+  /// Places a TNT array [x][y][k] by its first (rows) or second index.
+  template <class T>
+  void array3d(const std::string& name, TNT::Array3D<T>& array, bool by_rows)
+  {
+    if (array.dim1() == 0) return;
+    const long n = array.dim2(), g = array.dim3();
+    if (!by_rows) by_rows = !fills_pages(array.dim2() - 2, sizeof(T) * g);
+    if (first_touch)
+    {
+      const int lines = (by_rows ? array.dim1() : array.dim2()) - 2;
+      TNT::Array3D<T> placed(array.dim1(), array.dim2(), array.dim3());
+      const T* from = &array[0][0][0];
+      T* to = &placed[0][0][0];
+      #pragma omp parallel
+      {
+        int first, last;
+        if (my_lines(lines, first, last))
+        {
+          if (first == 1) first = 0;
+          if (last == lines) last = (by_rows ? array.dim1() : array.dim2()) - 1;
+          if (by_rows)
+          {
+            std::copy(from + first * n * g, from + (last + 1) * n * g,
+                      to + first * n * g);
+          }
+          else
+          {
+            for (long x = 0; x < array.dim1(); x++)
+            {
+              std::copy(from + (x * n + first) * g,
+                        from + (x * n + last + 1) * g, to + (x * n + first) * g);
+            }
+          }
+        }
+      }
+      array = placed;
+    }
+    add(name, by_rows, &array[0][0][0], sizeof(T) * array.dim1() * n * g);
+  }
+
+  void print_report() const
+  {
+    std::cout << "Array placement (memory node of the pages):" << std::endl;
+    for (size_t a = 0; a < names.size(); a++)
+    {
+      std::cout << "  " << names[a] << " (" << sizes[a] / 1024 << " kB, by "
+                << (rows[a] ? "rows" : "columns") << "): "
+                << LSDPlacement::describe_placement(starts[a], sizes[a])
+                << std::endl;
+    }
+  }
+
+private:
+  bool first_touch;
+  std::vector<std::string> names;
+  std::vector<bool> rows;
+  std::vector<const void*> starts;
+  std::vector<size_t> sizes;
+
+  void add(const std::string& name, bool by_rows, const void* start,
+           size_t bytes)
+  {
+    names.push_back(name);
+    rows.push_back(by_rows);
+    starts.push_back(start);
+    sizes.push_back(bytes);
+  }
+
+  // Whether each thread's share of the columns 1..lines, line_bytes each,
+  // comes to at least a page of every row.
+  static bool fills_pages(int lines, size_t line_bytes)
+  {
+    int threads = 1;
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    threads = omp_get_max_threads();
+    #endif
+    return static_cast<long>((lines / threads) * line_bytes) >=
+           LSDPlacement::page_size();
+  }
+
+  // The lines 1..lines of the calling thread in the static split.
+  static bool my_lines(int lines, int& first, int& last)
+  {
+    int thread = 0, threads = 1;
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    thread = omp_get_thread_num();
+    threads = omp_get_num_threads();
+    #endif
+    LSDWorkPartition split(STATIC_SCHEDULE, lines, threads);
+    if (thread >= split.chunks()) return false;
+    first = split.first(thread);
+    last = split.last(thread);
+    return true;
+  }
+};
+
+void LSDCatchmentModel::place_arrays()
+{
+  if (thread_affinity != NO_AFFINITY)
+  {
+    if (!LSDPlacement::pin_threads(thread_affinity))
+    {
+      std::cout << "Could not pin the threads to CPUs (more threads than "
+                << "CPUs, or not supported here). Carrying on unpinned."
+                << std::endl;
+    }
+  }
+  if (!numa_first_touch && !placement_report) return;
+
+  // The same lines as the hydro kernels work along. The wet lists go by
+  // their own index: down_scan[y], cross_scan[x].
+  if (numa_first_touch) LSDPlacement::use_fresh_pages();
+  ArrayPlacer placer(numa_first_touch);
+  const bool rows = row_major_traversal;
+  placer.grid("elev", elev, rows);
+  placer.grid("water_depth", water_depth, rows);
+  placer.grid("qx", qx, rows);
+  placer.grid("qy", qy, rows);
+  placer.grid("qxs", qxs, rows);
+  placer.grid("qys", qys, rows);
+  placer.grid("Vel", Vel, rows);
+  placer.grid("Tau", Tau, rows);
+  placer.grid("area", area, rows);
+  placer.grid("area_depth", area_depth, rows);
+  placer.grid("index", index, rows);
+  placer.grid("elev_diff", elev_diff, rows);
+  placer.grid("bedrock", bedrock, rows);
+  placer.grid("tempcreep", tempcreep, rows);
+  placer.grid("init_elevs", init_elevs, rows);
+  placer.grid("Vsusptot", Vsusptot, rows);
+  placer.grid("spat_var_mannings", spat_var_mannings, rows);
+  placer.grid("edge", edge, rows);
+  placer.grid("edge2", edge2, rows);
+  placer.grid("ss", ss, rows);
+  placer.grid("wet_state", wet_state, rows);
+  placer.grid("wet_neighbours", wet_neighbours, rows);
+  placer.grid("wet_pending", wet_pending, rows);
+  placer.grid("down_scan", down_scan, true);
+  placer.grid("eroding_cells", eroding_cells, true);
+  placer.grid("cross_scan", cross_scan, true);
+  placer.array3d("vel_dir", vel_dir, rows);
+  placer.array3d("veg", veg, rows);
+  placer.array3d("bedload", bedload, rows);
+  placer.array3d("erosion_rate", erosion_rate, rows);
+  placer.array3d("erosion_weight", erosion_weight, rows);
+  placer.array3d("lateral_take", lateral_take, rows);
+  placer.array3d("lateral_grain", lateral_grain, rows);
+
+  if (placement_report)
+  {
+    std::cout << "Thread placement:" << std::endl;
+    #pragma omp parallel
+    {
+      int thread = 0, cpu, node;
+      #ifdef OMP_COMPILE_FOR_PARALLEL
+      thread = omp_get_thread_num();
+      #endif
+      LSDPlacement::current_cpu(cpu, node);
+      #pragma omp critical
+      std::cout << "  thread " << thread << ": CPU " << cpu << ", node "
+                << node << std::endl;
+    }
+    placer.print_report();
+  }
+}
+
+// Inserts value into the sorted, zero terminated list[1..len]. The slots
+// past the end of the list are always kept at zero.
+static void wet_list_insert(int* list, int& len, int value)
+{
+  int* first = list + 1;
+  int* last = first + len;
+  int* pos = std::lower_bound(first, last, value);
+  std::memmove(pos + 1, pos, (last - pos) * sizeof(int));
+  *pos = value;
+  len++;
+}
+
+static void wet_list_erase(int* list, int& len, int value)
+{
+  int* first = list + 1;
+  int* last = first + len;
+  int* pos = std::lower_bound(first, last, value);
+  std::memmove(pos, pos + 1, (last - pos - 1) * sizeof(int));
+  list[len] = 0;
+  len--;
+}
+
+void LSDCatchmentModel::rebuild_wet_frontier()
+{
+  scan_area();
+
+  const bool use_down = !row_major_traversal || !hydro_only;
+  active_cells = 0;
+  #pragma omp parallel for reduction(+:active_cells)
+  for (unsigned i=1; i <= imax; i++)
+  {
+    for (unsigned j=1; j <= jmax; j++)
+    {
+      wet_state[i][j] = (water_depth[i][j] > 0) ? 1 : 0;
+      wet_pending[i][j] = 0;
+
+      int count = 0;
+      for (int di=-1; di <= 1; di++)
+      {
+        for (int dj=-1; dj <= 1; dj++)
+        {
+          if (water_depth[i + di][j + dj] > 0) count++;
+        }
+      }
+      wet_neighbours[i][j] = count;
+      if (count > 0) active_cells++;
+    }
+  }
+  wet_pending_cells.clear();
+
+  if (use_down)
+  {
+    for (unsigned j=1; j <= jmax; j++)
+    {
+      int len = 0;
+      while (down_scan[j][len + 1] > 0) len++;
+      down_scan_len[j] = len;
+    }
+  }
+  if (row_major_traversal)
+  {
+    for (unsigned i=1; i <= imax; i++)
+    {
+      int len = 0;
+      while (cross_scan[i][len + 1] > 0) len++;
+      cross_scan_len[i] = len;
+    }
+  }
+  wet_frontier_built = true;
+}
+
+void LSDCatchmentModel::shift_wet_neighbours(int x, int y, int delta)
+{
+  const bool use_down = !row_major_traversal || !hydro_only;
+  for (int i = x - 1; i <= x + 1; i++)
+  {
+    if (i < 1 || i > static_cast<int>(imax)) continue;
+    for (int j = y - 1; j <= y + 1; j++)
+    {
+      if (j < 1 || j > static_cast<int>(jmax)) continue;
+
+      int before = wet_neighbours[i][j];
+      wet_neighbours[i][j] = before + delta;
+      if (delta > 0 && before == 0)
+      {
+        if (use_down) wet_list_insert(down_scan.row(j), down_scan_len[j], i);
+        if (row_major_traversal) wet_list_insert(cross_scan.row(i), cross_scan_len[i], j);
+        active_cells++;
+      }
+      else if (delta < 0 && before == 1)
+      {
+        if (use_down) wet_list_erase(down_scan.row(j), down_scan_len[j], i);
+        if (row_major_traversal) wet_list_erase(cross_scan.row(i), cross_scan_len[i], j);
+        active_cells--;
+      }
+    }
+  }
+}
+
+void LSDCatchmentModel::update_wet_frontier()
+{
+  if (!wet_frontier_built)
+  {
+    rebuild_wet_frontier();
+  }
+  else
+  {
+    // Only cells on the wet lists have had their depth changed by
+    // depth_update(), so they and the cells given water from the
+    // inputs are the only ones that can have switched state.
+    const bool use_down = !row_major_traversal || !hydro_only;
+    std::vector< std::pair<int, int> > switched;
+
+    #pragma omp parallel
+    {
+      std::vector< std::pair<int, int> > local;
+      if (use_down)
+      {
+        #pragma omp for
+        for (unsigned y=1; y <= jmax; y++)
+        {
+          const int* wet_rows = down_scan.row(y);
+          for (int inc = 1; wet_rows[inc] > 0; inc++)
+          {
+            int x = wet_rows[inc];
+            if ((water_depth[x][y] > 0) != (wet_state[x][y] != 0))
+            {
+              local.push_back(std::make_pair(x, static_cast<int>(y)));
+            }
+          }
+        }
+      }
+      else
+      {
+        #pragma omp for
+        for (unsigned x=1; x <= imax; x++)
+        {
+          const int* wet_cols = cross_scan.row(x);
+          for (int inc = 1; wet_cols[inc] > 0; inc++)
+          {
+            int y = wet_cols[inc];
+            if ((water_depth[x][y] > 0) != (wet_state[x][y] != 0))
+            {
+              local.push_back(std::make_pair(static_cast<int>(x), y));
+            }
+          }
+        }
+      }
+      #pragma omp critical
+      switched.insert(switched.end(), local.begin(), local.end());
+    }
 
-void LSDCatchmentModel::scan_area()
-{
-  #pragma omp parallel for
-  for (unsigned j=1; j <= jmax; j++)
-  {
-    int inc = 1;
-    for (unsigned i=1; i <= imax; i++)
+    for (unsigned n = 0; n < wet_pending_cells.size(); n++)
     {
-      // zero scan bit..
-      down_scan[j][i] = 0;
-      // and work out scanned area. // TO DO (DAV) there is some out-of-bounds indexing going on here, check carefully!
-      if (water_depth[i][j] > 0
-          || water_depth[i][j - 1] > 0
-          || water_depth[i][j + 1] > 0
-          || water_depth[i - 1][j] > 0
-          || water_depth[i - 1][j - 1] > 0
-          || water_depth[i - 1][j + 1] > 0
-          || water_depth[i + 1][j - 1] > 0
-          || water_depth[i + 1][j + 1] > 0
-          || water_depth[i + 1][j] > 0
-          )
-      {
-        down_scan[j][inc] = i;
-        inc++;
-        // inc will increment everytime there is water found in a cell
-      }
+      wet_pending[wet_pending_cells[n].first][wet_pending_cells[n].second] = 0;
+    }
+    switched.insert(switched.end(), wet_pending_cells.begin(),
+                    wet_pending_cells.end());
+    wet_pending_cells.clear();
+
+    // A cell can be listed twice (on the wet list and an input), so the
+    // state is checked again as each one is applied.
+    for (unsigned n = 0; n < switched.size(); n++)
+    {
+      int x = switched[n].first;
+      int y = switched[n].second;
+      unsigned char wet = (water_depth[x][y] > 0) ? 1 : 0;
+      if (wet == wet_state[x][y]) continue;
+      wet_state[x][y] = wet;
+      shift_wet_neighbours(x, y, wet ? 1 : -1);
     }
   }
-}
 
+  active_fraction_sum += static_cast<double>(active_cells) / (imax * jmax);
+  active_fraction_samples++;
+}
 
 // __________________________________________
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -3893,16 +5628,9 @@ void LSDCatchmentModel::sort_active(int x,int y)
 
   if (total > (active*1.5)) // depositing - create new strata layer and remove bottom one..
   {
-    // start from bottom
-    // remove bottom active layer
-    // then move all from layer above into one below, up to the top layer
-    for(unsigned z=9;z>=1;z--)
-    {
-      for(unsigned n=0;n<=G_MAX-2;n++)
-      {
-        strata[xyindex][z][n]=strata[xyindex][z-1][n];
-      }
-    }
+    // remove bottom active layer, moving all the others down one, with
+    // a copy of the top layer on top (see LSDStrataPool::push_layer())
+    strata.push_layer(xyindex);
 
     // then remove strata thickness from grain - and add to top strata layer
     coeff = active / total;
@@ -3926,18 +5654,13 @@ void LSDCatchmentModel::sort_active(int x,int y)
       grain[xyindex][n] += strata[xyindex][0][n-1];
     }
 
-    // then from top down add lower strata into upper
-    for(unsigned z=0;z<=8;z++)
-    {
-      for(unsigned n=0;n<=G_MAX-2;n++)
-      {
-        strata[xyindex][z][n] = strata[xyindex][z+1][n];
-      }
-    }
+    // then move all the lower strata up one; the top layer's row
+    // becomes the bottom one
+    strata.pop_layer(xyindex);
 
     // add new layer at the bottom
     amount = active;
-    int z = 9;
+    int z = strata_layers - 1;
     for (unsigned n=1; n<=G_MAX-1; n++)
     {
         strata[xyindex][z][n-1] = amount * dprop[n];
@@ -3948,25 +5671,34 @@ void LSDCatchmentModel::sort_active(int x,int y)
  // NEW METHOD for N number of grain sizes
 void LSDCatchmentModel::addGS(int x, int y)
 {
-  #pragma omp critical(addGS)
-  {
+  // Only taking the next slot needs to be atomic; the slot is this
+  // thread's alone once it has it
+  int slot;
+  #pragma omp atomic capture
+  slot = ++grain_array_tot;
+  grain.reserve(slot + 1);
+  strata.reserve(slot + 1);
+
+  init_GS(x, y, slot);
+}
 
-  grain_array_tot++;
-  index[x][y] = grain_array_tot;
+void LSDCatchmentModel::init_GS(int x, int y, int slot)
+{
+  index[x][y] = slot;
 
-  grain[grain_array_tot][0] = 0;
+  grain[slot][0] = 0;
   for (unsigned n = 1; n <= G_MAX - 1;n++ )
   {
-      grain[grain_array_tot][n] = active * dprop[n];
+      grain[slot][n] = active * dprop[n];
   }
-  grain[grain_array_tot][G_MAX] = 0;
+  grain[slot][G_MAX] = 0;
 
 
-  for (unsigned n = 0; n <= 9; n++) // Do we always need 9 strata? Future improvement?
+  for (unsigned n = 0; n < strata_layers; n++)
   {
       for (unsigned n2 = 0; n2 <= G_MAX-2; n2++ )
       {
-          strata[grain_array_tot][n][n2] = (active) * dprop[n2+1];
+          strata[slot][n][n2] = (active) * dprop[n2+1];
       }
 
 
@@ -3974,12 +5706,11 @@ void LSDCatchmentModel::addGS(int x, int y)
       {
           for (unsigned q = 0; q <= (G_MAX - 2); q++)
           {
-              strata[grain_array_tot][n][q] = 0;
+              strata[slot][n][q] = 0;
           }
       }
   }
   sort_active(x, y);
-  }
 }
 
 double LSDCatchmentModel::sand_fraction(int index1)
@@ -4040,7 +5771,7 @@ double LSDCatchmentModel::d50(int index1)
 
   double active_thickness=0;
   double Dfifty=0,max=0,min=0;
-  std::array<double, 20> cum_tot{};  // std::array only C++11
+  std::array<double, MAX_FRACTIONS + 2> cum_tot{};  // std::array only C++11
 
   for(unsigned n=1;n<=G_MAX;n++)
   {
@@ -4053,20 +5784,14 @@ double LSDCatchmentModel::d50(int index1)
 
 
   int i=1;
-  while(cum_tot[i]<(active_thickness*0.5) && i<=9)
+  const int fractions = G_MAX - 1;
+  while(cum_tot[i]<(active_thickness*0.5) && i<=fractions)
   {
     i++;
   }
 
-  if(i==1){min=std::log(d1);max=std::log(d1);}
-  if(i==2){min=std::log(d1);max=std::log(d2);}
-  if(i==3){min=std::log(d2);max=std::log(d3);}
-  if(i==4){min=std::log(d3);max=std::log(d4);}
-  if(i==5){min=std::log(d4);max=std::log(d5);}
-  if(i==6){min=std::log(d5);max=std::log(d6);}
-  if(i==7){min=std::log(d6);max=std::log(d7);}
-  if(i==8){min=std::log(d7);max=std::log(d8);}
-  if(i==9){min=std::log(d8);max=std::log(d9);}
+  if(i==1){min=log_grain_sizes[1];max=log_grain_sizes[1];}
+  else if(i<=fractions){min=log_grain_sizes[i-1];max=log_grain_sizes[i];}
 
   Dfifty = std::exp(max - ((max - min) * ((cum_tot[i] - (active_thickness * 0.5)) / (cum_tot[i] - cum_tot[i - 1]))));
   if(active_thickness<0.0000001)Dfifty=0;
@@ -4170,6 +5895,259 @@ void LSDCatchmentModel::slide_GS(int x,int y, double amount,int x2, int y2)
   }
 }
 
+void LSDCatchmentModel::take_GS(int x, int y, double amount, double* moved)
+{
+  for (unsigned n = 0; n <= G_MAX; n++) moved[n] = 0;
+
+  // A cell with no grain size record gives the default mixture
+  if (index[x][y] == -9999)
+  {
+    for (unsigned n = 1; n <= G_MAX - 1; n++) moved[n] = amount * dprop[n];
+    return;
+  }
+
+  double total = 0;
+  for (unsigned n = 1; n <= G_MAX - 1; n++)
+  {
+    if (grain[index[x][y]][n] > 0) total += grain[index[x][y]][n];
+  }
+  // More than the active layer holds: the rest is the default mixture
+  if (amount > total)
+  {
+    for (unsigned n = 1; n <= G_MAX - 1; n++)
+    {
+      moved[n] += (amount - total) * dprop[n];
+    }
+    amount = total;
+  }
+  if (total > 0)
+  {
+    for (unsigned n = 1; n <= G_MAX - 1; n++)
+    {
+      double transferamt = amount * (grain[index[x][y]][n] / total);
+      moved[n] += transferamt;
+      grain[index[x][y]][n] -= transferamt;
+      if (grain[index[x][y]][n] < 0) grain[index[x][y]][n] = 0;
+    }
+  }
+  sort_active(x, y);
+}
+
+void LSDCatchmentModel::add_new_GS()
+{
+  // Columns 0..jmax can hold new records, column 0 goes with the first
+  // chunk. Each column only writes to its own cells.
+  std::vector<int> found(jmax + 2, 0);
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_first = (column_work.first(c) == 1) ? 0 : column_work.first(c);
+    for (int y = y_first; y <= column_work.last(c); y++)
+    {
+      new_GS_in_column(y, false, found[y]);
+    }
+  }
+
+  // The records are numbered column by column, so the numbers do not
+  // depend on the threads
+  std::vector<int> last_slot(jmax + 2, 0);
+  for (unsigned y = 0; y <= jmax; y++)
+  {
+    last_slot[y] = grain_array_tot;
+    grain_array_tot += found[y];
+  }
+  grain.reserve(grain_array_tot + 1);
+  strata.reserve(grain_array_tot + 1);
+
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_first = (column_work.first(c) == 1) ? 0 : column_work.first(c);
+    for (int y = y_first; y <= column_work.last(c); y++)
+    {
+      if (found[y] > 0) new_GS_in_column(y, true, last_slot[y]);
+    }
+  }
+}
+
+void LSDCatchmentModel::new_GS_in_column(int y, bool assign, int& counter)
+{
+  // The wet cells of the column erosion_rates() works on, and their
+  // neighbours in the column
+  if (y >= 1 && y < static_cast<int>(jmax))
+  {
+    int inc = 1;
+    while (down_scan[y][inc] > 0)
+    {
+      int x = down_scan[y][inc];
+      inc++;
+      if (water_depth[x][y] > water_depth_erosion_threshold)
+      {
+        new_GS_cell(x, y, assign, counter);
+        for (int dx = -1; dx <= 1; dx += 2)
+        {
+          if (water_depth[x + dx][y] > water_depth_erosion_threshold)
+          {
+            new_GS_cell(x + dx, y, assign, counter);
+          }
+        }
+      }
+    }
+  }
+  // The neighbours of the wet cells in the columns either side
+  for (int side = -1; side <= 1; side += 2)
+  {
+    const int y2 = y + side;
+    if (y2 < 1 || y2 >= static_cast<int>(jmax)) continue;
+    int inc = 1;
+    while (down_scan[y2][inc] > 0)
+    {
+      int x = down_scan[y2][inc];
+      inc++;
+      if (water_depth[x][y2] > water_depth_erosion_threshold &&
+          water_depth[x][y] > water_depth_erosion_threshold)
+      {
+        new_GS_cell(x, y, assign, counter);
+      }
+    }
+  }
+}
+
+void LSDCatchmentModel::new_GS_cell(int x, int y, bool assign, int& counter)
+{
+  // -1 marks a cell found in the first walk, which gets its record in
+  // the second
+  if (!assign)
+  {
+    if (index[x][y] == -9999)
+    {
+      index[x][y] = -1;
+      counter++;
+    }
+  }
+  else if (index[x][y] == -1)
+  {
+    init_GS(x, y, ++counter);
+  }
+}
+
+void LSDCatchmentModel::lateral_erosion(int dx, int dy,
+                                        const TNT::Array2D<double>& erodetot3,
+                                        double mult_factor)
+{
+  // Banks on the edge lines are never eroded
+  const int line_max = (dx == 1) ? imax : jmax;
+  const int slots = G_MAX + 1;
+
+  // 1. How much each eroding cell (eroding_cells, from the first pass of
+  // erode()) takes from the bank on its low (side 0) and high (side 1) face
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_last = std::min(column_work.last(c), static_cast<int>(jmax) - 1);
+    for (int y = std::max(column_work.first(c), 2); y <= y_last; y++)
+    {
+      int inc = 1;
+      while (eroding_cells[y][inc] > 0)
+      {
+        int x = eroding_cells[y][inc];
+        inc++;
+        for (int side = 0; side <= 1; side++)
+        {
+          const int bx = (side == 1) ? x + dx : x - dx;
+          const int by = (side == 1) ? y + dy : y - dy;
+          const int along = (dx == 1) ? bx : by;
+          double amt = 0;
+          if (elev[bx][by] > elev[x][y])
+          {
+            if (water_depth[bx][by] < water_depth_erosion_threshold)
+            {
+              amt = mult_factor * lateral_constant * Tau[x][y] * edge[bx][by] * erosion_step / DX;
+            }
+            else
+            {
+              amt = chann_lateral_erosion * erodetot3[x][y] * (elev[bx][by] - elev[x][y]) / DX * 0.1;
+            }
+            if (amt > 0)
+            {
+              amt *= 1 - (veg[bx][by][1] * (1 - veg_lat_restriction));
+              if ((elev[bx][by] - amt) < bedrock[bx][by] || along == 1 ||
+                  along == line_max) amt = 0;
+              if (amt > ERODEFACTOR * 0.1) amt = ERODEFACTOR * 0.1;
+            }
+          }
+          lateral_take[x][y][side] = (amt > 0) ? amt : 0;
+        }
+      }
+    }
+  }
+
+  // 2. Each bank gives up what was taken from it, to the cell below it
+  // (along the direction) first, then the one above. The grain sizes
+  // go into the taking cell's lateral_grain.
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    for (int y = column_work.first(c); y <= column_work.last(c); y++)
+    {
+      for (int side = 1; side >= 0; side--)
+      {
+        const int sign = (side == 1) ? 1 : -1;
+        const int taker_y = y - sign * dy;
+        if (taker_y < 2 || taker_y > static_cast<int>(jmax) - 1) continue;
+        int inc = 1;
+        while (eroding_cells[taker_y][inc] > 0)
+        {
+          int taker_x = eroding_cells[taker_y][inc];
+          inc++;
+          double amt = lateral_take[taker_x][taker_y][side];
+          if (amt > 0)
+          {
+            int x = taker_x + sign * dx;
+            elev[x][y] -= amt;
+            note_height_change(x, y);
+            take_GS(x, y, amt, &lateral_grain[taker_x][taker_y][side * slots]);
+          }
+        }
+      }
+    }
+  }
+
+  // 3. Each eroding cell adds what it took. Every cell that takes has a
+  // grain size record (see add_new_GS()).
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_last = std::min(column_work.last(c), static_cast<int>(jmax) - 1);
+    for (int y = std::max(column_work.first(c), 2); y <= y_last; y++)
+    {
+      int inc = 1;
+      while (eroding_cells[y][inc] > 0)
+      {
+        int x = eroding_cells[y][inc];
+        inc++;
+        double elev_update = 0;
+        for (int side = 0; side <= 1; side++)
+        {
+          double amt = lateral_take[x][y][side];
+          if (amt > 0)
+          {
+            elev_update += amt;
+            const double* moved = &lateral_grain[x][y][side * slots];
+            for (unsigned n = 1; n <= G_MAX - 1; n++)
+            {
+              grain[index[x][y]][n] += moved[n];
+            }
+            sort_active(x, y);
+          }
+        }
+        elev[x][y] += elev_update;
+        if (elev_update != 0) note_height_change(x, y);
+      }
+    }
+  }
+}
+
 // Interlude. Here's a relaxing picture of a lighthouse:
 //
 //      ----------.................._____________  _  .-.
@@ -4182,63 +6160,24 @@ void LSDCatchmentModel::slide_GS(int x,int y, double amount,int x2, int y2)
 // _a:f____________________________________________ .[__N]. _______
 
 
-//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-//
-// EROSION ROUTINE(S)
-//
-// This huge (sorry - will be refactored eventually!)
-// block of code does the erosion
-// in the model. It iterates over every cell
-// in the domain and calculates amounts to be
-// entrained into bedload and suspended load,
-// and the amount to erode or deposit. As you
-// may imagine, it's probably the most
-// compuationally expensive part of the code.
-// Especially when using multiple grain size
-// fracions.
-//
-// The Wilcock or Einstein models of sediment
-// transport can be used. Bedrock incision is
-// calculated using the simple stream power law.
-//
-// TO DO
-// It really ought to be split into smaller
-// functions, but it is what it is for now.
-//
-// Based on the erode function in CAESAR-Lisflood
-//
-//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=
-double LSDCatchmentModel::erode(double mult_factor)
+// The first pass of erode(): works out the shear stress on each wet cell
+// (Tau), the rate at which it entrains each grain size (erosion_rate, in
+// metres per second of erosion_step * mult_factor) and the share of what it
+// entrains that goes to each neighbour (erosion_weight). None of these
+// depend on the time step, so when erode() has to shorten it, only
+// erosion_transfers() is run again.
+template <class Options>
+void LSDCatchmentModel::erosion_rates()
 {
-
+  const Options opts(runtime_options);
+  // The grain size fractions are 1..fractions
+  const unsigned fractions = opts.fractions;
   const double rho = 1000.0;
-  double tempbmax = 0;
-  float gtot2[20] = {};
-  //double flow_timestep = 0;
-
-  time_step = time_step * 1.5;
-
-  // Deal with erosion timestep
-//  switch (erode_timestep_type)
-//  {
-//    case 0:  // Erosion controls global time step and thus next hydro timestep
-//      time_step = time_step * 1.5;
-//      if (time_step > max_time_step) time_step = max_time_step;
-//      flow_timestep = time_step;
-//      break;
-
-//    case 1:  // Erosion uses local timestep: global timestep and thus hydro timestep not affected
-//      flow_timestep = time_step * 1.5;
-//      if (flow_timestep > max_time_step) flow_timestep = max_time_step;
-//      break;
-//  }
-
-  do
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
   {
-  tempbmax = 0;
-#pragma omp parallel for reduction(max:tempbmax) \
-//  private(tempdir, temp_dist, temptot2, veltot, vel, qtot, tau, velnum, slopetot) schedule(runtime)
-    for (unsigned int y = 1; y < jmax; ++y)
+    const int y_last = std::min(column_work.last(c), static_cast<int>(jmax) - 1);
+    for (int y = std::max(column_work.first(c), 1); y <= y_last; y++)
     {
       int inc = 1;
       while (down_scan[y][inc] > 0)
@@ -4251,12 +6190,10 @@ double LSDCatchmentModel::erode(double mult_factor)
         Vel[x][y] = 0;
         Tau[x][y] = 0;
 
-        for (unsigned n = 0; n < G_MAX; n++)
+        // erosion_transfers() only visits the cells that entrain
+        for (unsigned n = 0; n <= fractions; n++)
         {
-          sr[x][y][n] = 0;
-          sl[x][y][n] = 0;
-          su[x][y][n] = 0;
-          sd[x][y][n] = 0;
+          bedload[x][y][n] = 0;
         }
         ss[x][y] = 0;
 
@@ -4272,22 +6209,16 @@ double LSDCatchmentModel::erode(double mult_factor)
           double slopetot = 0;
 
           double tempdir[11] = {};
-          double temp_dist[11] = {};
-
-//          for (int i =0; i<11; ++i)
-//          {
-//            tempdir[i] =0;
-//            temp_dist[i] =0;
-//          }
 
           // add spatial mannings here
-          if (spatially_var_mannings)
+          // (kept local to the cell: the member is shared by all threads)
+          double mannings = this->mannings;
+          if (opts.spatial_mannings)
           {
              mannings = spat_var_mannings[x][y];
           }
 
-          // check to see if index for that cell...
-          if (index[x][y] == -9999) addGS(x, y);
+          // The cell already has a grain size record (see add_new_GS())
 
           // now tot up velocity directions, velocities and edge directions.
           for (int p = 1; p <= 8; p+=2)
@@ -4333,419 +6264,458 @@ double LSDCatchmentModel::erode(double mult_factor)
             Tau[x][y] = tau;
           }
 
-          // now do some erosion
+          // now work out the entrainment rates
           if (tau > 0)
           {
             double d_50 = 0;
             double Fs = 0;
             double Di = 0;
             double graintot = 0;
-            if (wilcock == 1)
+            // The parts of the Wilcock and Crowe law that are the same
+            // for every fraction
+            double tau_rm = 0, U_star = 0;
+            double log_d50 = 0, log_tau_rm = 0, log_tau = 0;
+            if (opts.wilcock)
             {
               d_50 = d50(index[x][y]);
-              if (d_50 < d1) d_50 = d1;
+              if (d_50 < grain_sizes[1]) d_50 = grain_sizes[1];
               Fs = sand_fraction(index[x][y]);
-              for (unsigned n = 1; n <= G_MAX; n++)graintot += (grain[index[x][y]][n]);
+              for (unsigned n = 1; n <= fractions + 1; n++)graintot += (grain[index[x][y]][n]);
+              U_star = std::sqrt(tau / rho);
+              if (use_transport_tables)
+              {
+                const double factor = wilcock_tables.reference_factor(Fs);
+                log_d50 = std::log(d_50);
+                log_tau_rm = std::log(factor * (rho * gravity * d_50));
+                log_tau = std::log(tau);
+              }
+              else
+              {
+                tau_rm = wilcock_reference_factor(Fs) * (rho * gravity * d_50);
+              }
             }
 
-            double temptot1 = 0;
-
-            for (unsigned int n = 1; n <= G_MAX-1; n++)
+            for (unsigned int n = 1; n <= fractions; n++)
             {
-              switch (n)
-              {
-                case 1: Di = d1; break;
-                case 2: Di = d2; break;
-                case 3: Di = d3; break;
-                case 4: Di = d4; break;
-                case 5: Di = d5; break;
-                case 6: Di = d6; break;
-                case 7: Di = d7; break;
-                case 8: Di = d8; break;
-                case 9: Di = d9; break;
-              }
+              Di = grain_sizes[n];
+              double rate = 0;
 
               // Wilcock and Crowe/Curran
 
-              if (wilcock == 1)
+              if (opts.wilcock)
               {
-                double tau_ri = 0, U_star, Wi_star;
-                tau_ri = (0.021 + (0.015 * std::exp(-20 * Fs))) * (rho * gravity * d_50) * std::pow((Di / d_50), (0.67 / (1 + std::exp(1.5 - (Di / d_50)))));
-                U_star = std::pow(tau / rho, 0.5);
-                double Fi = grain[index[x][y]][n] / graintot;
-
-                if ((tau / tau_ri) < 1.35)
+                double Wi_star;
+                if (use_transport_tables)
                 {
-                  Wi_star = 0.002 * std::pow(tau / tau_ri, 7.5);
+                  // ln(tau / tau_ri), with the hiding function from its table
+                  const double log_ratio = log_grain_sizes[n] - log_d50;
+                  const double log_phi = log_tau - log_tau_rm
+                                         - wilcock_tables.log_hiding(log_ratio);
+                  Wi_star = wilcock_tables.transport(log_phi);
                 }
                 else
                 {
-                  Wi_star = 14 * std::pow(1 - (0.894 / std::pow(tau / tau_ri, 0.5)), 4.5);
+                  const double tau_ri = tau_rm * std::pow((Di / d_50), (0.67 / (1 + std::exp(1.5 - (Di / d_50)))));
+                  Wi_star = wilcock_transport(tau / tau_ri);
                 }
+                double Fi = grain[index[x][y]][n] / graintot;
                 //maybe should divide by DX as well..
-                temp_dist[n] = mult_factor * time_step *
-                               ((Fi * (U_star * U_star * U_star)) / ((2.65 - 1) * gravity)) * Wi_star / DX;
+                rate = ((Fi * (U_star * U_star * U_star)) / ((2.65 - 1) * gravity)) * Wi_star / DX;
               }
               // Einstein sed tpt eqtn
-              if (einstein == 1)
+              if (opts.einstein)
               {
                 // maybe should divide by DX as well..
-                temp_dist[n] = mult_factor * time_step * (40 * std::pow((1 / (((2650 - 1000) * Di) / (tau / gravity))), 3))
-                               / std::sqrt(1000 / ((2250 - 1000) * gravity * (Di * Di * Di))) / DX;
-              }
-
-              //if (temp_dist[n] < 0.0000000000001) temp_dist[n] = 0;
-
-              // first check to see that theres not too little sediment in a cell to be entrained
-              if (temp_dist[n] > grain[index[x][y]][n])
-              {
-                temp_dist[n] = grain[index[x][y]][n];
-              }
-              // then check to see if this would make SS levels too high.. and if so reduce
-              if (isSuspended[n] && n == 1)
-              {
-                if ((temp_dist[n] + Vsusptot[x][y]) / water_depth[x][y] > Csuspmax)
-                {
-                  //work out max amount of sediment that can be there (waterdepth * csuspmax) then subtract whats already there
-                  // (Vsusptot) to leave what can be entrained. Check if < 0 after.
-                  temp_dist[n] = (water_depth[x][y] * Csuspmax) - Vsusptot[x][y];
-                }
+                const double psi = 1 / (einstein_psi_size[n] / (tau / gravity));
+                rate = (40 * (psi * psi * psi)) / einstein_settling[n] / DX;
               }
-              if (temp_dist[n] < 0) temp_dist[n] = 0;
-
-              // nwo placed here speeding up reduction of erode repeats.
-              temptot1 += temp_dist[n];
+              erosion_rate[x][y][n] = rate;
             }
 
-            //check if this makes it below bedrock
-            if (elev[x][y] - temptot1 <= bedrock[x][y])
+            // now work out what portion of bedload has to go where...
+            for (int p = 1; p <= 8; p += 2)
             {
-              // now remove from proportion that can be eroded..
-              // we can do this as we have the prop (in temptot) that is there to be eroded.
-              double elevdiff = elev[x][y] - bedrock[x][y];
-              double temptot3 = temptot1;
-              temptot1 = 0;
-              for (unsigned int n = 1; n <= G_MAX-1; n++)
+              int x2 = x + deltaX[p];
+              int y2 = y + deltaY[p];
+              double factor = 0;
+
+              if (water_depth[x2][y2] > water_depth_erosion_threshold)
               {
-                if (elev[x][y] <= bedrock[x][y])
-                {
-                  temp_dist[n] = 0;
-                }
-                else
+                // vel slope
+                if (vel_dir[x][y][p] > 0)
                 {
-                  temp_dist[n] = elevdiff * (temp_dist[n] / temptot3);
-                  if (temp_dist[n] < 0) temp_dist[n] = 0;
+                  factor += 0.75 * tempdir[p] / veltot;
                 }
-                temptot1 += temp_dist[n];
-              }
-
-              // here insert bedrock erosion routine?
-              if (tau > bedrock_erosion_threshold)
-              {
-                double amount = 0; // amount is amount of erosion into the bedrock.
-                amount = std::pow(bedrock_erosion_rate * tau, 1.5) * time_step * mult_factor * 0.000000317; // las value to turn it into erosion per year (number of years per second)
-                bedrock[x][y] -= amount;
-                // now add amount of bedrock eroded into sediment proportions.
-                for (unsigned int n2 = 1; n2 <= G_MAX - 1; n2++)
+                // now for lateral gradient.
+                if (edge[x][y] > edge[x2][y2])
                 {
-                  grain[index[x][y]][n2] += amount * dprop[n2];
+                  factor += 0.25 * ((edge[x][y] - edge[x2][y2]) / temptot2);
                 }
               }
+              erosion_weight[x][y][p / 2] = factor;
             }
+          }
+        }
+      }
+    }
+  }
+}
+
+// The second pass of erode(): works out how much of each grain size each
+// wet cell entrains in this time step (temp_dist), from the rates of
+// erosion_rates(), as bedload (bedload) or suspended load (ss), without
+// changing the bed.
+// Returns the deepest erosion of any cell, so erode() can shorten the time
+// step and run it again if it is too deep.
+// mult_factor includes the morphological factor, so temp_dist is the change
+// of the bed; only 1 / morphological_factor of the suspended part of it goes
+// into the water (see erode_step()).
+template <class Options>
+double LSDCatchmentModel::erosion_transfers(double mult_factor)
+{
+  const Options opts(runtime_options);
+  // The grain size fractions are 1..fractions
+  const unsigned fractions = opts.fractions;
+  const double step = mult_factor * erosion_step;
+  double tempbmax = 0;
+#pragma omp parallel for reduction(max:tempbmax) schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_last = std::min(column_work.last(c), static_cast<int>(jmax) - 1);
+    for (int y = std::max(column_work.first(c), 1); y <= y_last; y++)
+    {
+      int inc = 1;
+      while (down_scan[y][inc] > 0)
+      {
+        unsigned x = down_scan[y][inc];
+        inc++;
+
+        // Tau is only set on wet cells
+        const double tau = Tau[x][y];
+
+        // now do some erosion
+        if (tau > 0)
+        {
+          // (clear what an earlier pass at a longer time step sent)
+          ss[x][y] = 0;
+
+          double temp_dist[MAX_FRACTIONS + 2] = {};
+          double temptot1 = 0;
+
+          for (unsigned int n = 1; n <= fractions; n++)
+          {
+            temp_dist[n] = step * erosion_rate[x][y][n];
 
+            //if (temp_dist[n] < 0.0000000000001) temp_dist[n] = 0;
 
-            // veg components
-            // here to erode the veg layer..
-            if (veg[x][y][1] > 0 && tau > vegTauCrit)
+            // first check to see that theres not too little sediment in a cell to be entrained
+            if (temp_dist[n] > grain[index[x][y]][n])
             {
-              // now to remove from veg layer..
-              veg[x][y][1] -= mult_factor * time_step * std::pow(tau - vegTauCrit, 0.5) * 0.00001;
-              if (veg[x][y][1] < 0) veg[x][y][1] = 0;
+              temp_dist[n] = grain[index[x][y]][n];
             }
-
-            // now to determine if movement should be restricted due to veg... or because of bedrock...
-            if (veg[x][y][1] > 0.25)
+            // then check to see if this would make SS levels too high.. and if so reduce
+            if (n == 1 && opts.suspended)
             {
-              // now checks if this removed from the cell would put it below the veg layer..
-              if (elev[x][y] - temptot1 <= veg[x][y][0])
+              if ((temp_dist[n] / morphological_factor + Vsusptot[x][y]) / water_depth[x][y] > Csuspmax)
               {
-                // now remove from proportion that can be eroded..
-                // we can do this as we have the prop (in temptot) that is there to be eroded.
-                double elevdiff = 0;
-                elevdiff = elev[x][y] - veg[x][y][0];
-                if (elevdiff < 0) elevdiff = 0;
-                double temptot3 = temptot1;
-                temptot1 = 0;
-                for (unsigned n = 1; n <= G_MAX-1; n++)
-                {
-                  temp_dist[n] = elevdiff * (temp_dist[n] / temptot3);
-                  if (elev[x][y] <= veg[x][y][0]) temp_dist[n] = 0;
-                  temptot1 += temp_dist[n];
-                }
-                //temptot1 -= elevdiff;
-                if (temptot1 < 0) temptot1 = 0;
+                //work out max amount of sediment that can be there (waterdepth * csuspmax) then subtract whats already there
+                // (Vsusptot) to leave what can be entrained. Check if < 0 after.
+                temp_dist[n] = ((water_depth[x][y] * Csuspmax) - Vsusptot[x][y]) * morphological_factor;
               }
             }
+            if (temp_dist[n] < 0) temp_dist[n] = 0;
+
+            // nwo placed here speeding up reduction of erode repeats.
+            temptot1 += temp_dist[n];
+          }
 
-            if (temptot1 > tempbmax)
+          //check if this makes it below bedrock
+          if (opts.bedrock && elev[x][y] - temptot1 <= bedrock[x][y])
+          {
+            // now remove from proportion that can be eroded..
+            // we can do this as we have the prop (in temptot) that is there to be eroded.
+            double elevdiff = elev[x][y] - bedrock[x][y];
+            double temptot3 = temptot1;
+            temptot1 = 0;
+            for (unsigned int n = 1; n <= fractions; n++)
             {
-              tempbmax = temptot1;
+              if (elev[x][y] <= bedrock[x][y])
+              {
+                temp_dist[n] = 0;
+              }
+              else
+              {
+                temp_dist[n] = elevdiff * (temp_dist[n] / temptot3);
+                if (temp_dist[n] < 0) temp_dist[n] = 0;
+              }
+              temptot1 += temp_dist[n];
             }
 
-            // now work out what portion of bedload has to go where...
-            // only allow actual transfer of sediment if there is flow in a direction - i.e. some sedeiment transport
-            if(temptot1>0)
+            // here insert bedrock erosion routine?
+            if (tau > bedrock_erosion_threshold)
             {
-              for (int p = 1; p <= 8; p += 2)
+              double amount = 0; // amount is amount of erosion into the bedrock.
+              amount = std::pow(bedrock_erosion_rate * tau, 1.5) * erosion_step * mult_factor * 0.000000317; // las value to turn it into erosion per year (number of years per second)
+              bedrock[x][y] -= amount;
+              note_height_change(x, y);
+              // now add amount of bedrock eroded into sediment proportions.
+              for (unsigned int n2 = 1; n2 <= fractions; n2++)
               {
-                int x2 = x + deltaX[p];
-                int y2 = y + deltaY[p];
-
-                if (water_depth[x2][y2] > water_depth_erosion_threshold)
-                {
-                  if (index[x2][y2] == -9999) addGS(x2, y2);
-                  double factor = 0;
-
-                  // vel slope
-                  if (vel_dir[x][y][p] > 0)
-                  {
-                    factor += 0.75 * tempdir[p] / veltot;
-                  }
-                  // now for lateral gradient.
-                  if (edge[x][y] > edge[x2][y2])
-                  {
-                    factor += 0.25 * ((edge[x][y] - edge[x2][y2]) / temptot2);
-                  }
-
-                  // now loop through grainsizes
-                  for (unsigned n = 1; n <= G_MAX-1; n++)
-                  {
-                    if (temp_dist[n] > 0)
-                    {
-                      if (n == 1 && isSuspended[n])
-                      {
-                        // put amount entrained by ss in to ss[,]
-                        ss[x][y] = temp_dist[n];
-                      }
-                      else
-                      {
-                        switch (p)
-                        {
-                          case 1: su[x][y][n] = temp_dist[n] * factor; break;
-                          case 3: sr[x][y][n] = temp_dist[n] * factor; break;
-                          case 5: sd[x][y][n] = temp_dist[n] * factor; break;
-                          case 7: sl[x][y][n] = temp_dist[n] * factor; break;
-                        }
-                      }
-                    }
-                  }
-                }
+                grain[index[x][y]][n2] += amount * dprop[n2];
               }
             }
           }
-        }
-      }
-    }
-
-    if (tempbmax > ERODEFACTOR)
-    {
-      time_step *= (ERODEFACTOR / tempbmax) * 0.5;
-    }
-//      switch (erode_timestep_type)
-//      {
-//        case 0:
-//          time_step *= (ERODEFACTOR / tempbmax) * 0.5;
-//          flow_timestep = time_step;
-//          break;
-//        case 1:
-//          flow_timestep *= (ERODEFACTOR / tempbmax) * 0.5;
-//          break;
-//      }
-//    }
-  } while(tempbmax > ERODEFACTOR);
 
-  TNT::Array2D<double> erodetot(imax+2, jmax+2, 0.0);
-  TNT::Array2D<double> erodetot3(imax+2, jmax+2, 0.0);
 
-#pragma omp parallel for
-  for (unsigned y = 2; y < jmax; ++y)
-  {
-    int inc = 1;
-    while (down_scan[y][inc] > 0)
-    {
-      unsigned x = down_scan[y][inc];
-      inc++;
+          // veg components
+          // here to erode the veg layer..
+          if (opts.vegetation && veg[x][y][1] > 0 && tau > vegTauCrit)
+          {
+            // now to remove from veg layer..
+            veg[x][y][1] -= mult_factor * erosion_step * std::sqrt(tau - vegTauCrit) * 0.00001;
+            if (veg[x][y][1] < 0) veg[x][y][1] = 0;
+          }
 
-      if (water_depth[x][y] > water_depth_erosion_threshold && x < imax && x > 1)
-      {
-        if (index[x][y] == -9999) addGS(x, y);
-        for (unsigned int n = 1; n <= G_MAX-1; n++)
-        {
-          if (n == 1 && isSuspended[n])
+          // now to determine if movement should be restricted due to veg... or because of bedrock...
+          if (opts.vegetation && veg[x][y][1] > 0.25)
           {
-            // updating entrainment of SS
-            Vsusptot[x][y] += ss[x][y];
-            grain[index[x][y]][n] -= ss[x][y];
-            erodetot[x][y] -= ss[x][y];
-
-            // this next part is unusual. You have to stop susp sed deposition on the input cells, otherwies
-            // it drops sediment out, but cannot entrain as ss levels in input are too high leading to
-            // little mountains of sediment. This means a new array in order to check whether a cell is an
-            // input point or not..
-            if (!inputpointsarray[x][y])
+            // now checks if this removed from the cell would put it below the veg layer..
+            if (elev[x][y] - temptot1 <= veg[x][y][0])
             {
-              // now calc ss to be dropped
-              double coeff = (fallVelocity[n] * time_step) / water_depth[x][y];
-              if (coeff > 1) coeff = 1;
-              double Vpdrop = coeff * Vsusptot[x][y];
-              if (Vpdrop > 0.001) Vpdrop = 0.001; //only allow 1mm to be deposited per iteration
-              grain[index[x][y]][n] += Vpdrop;
-              erodetot[x][y] += Vpdrop;
-              Vsusptot[x][y] -= Vpdrop;
-              //if (Vsusptot[x][y] < 0) Vsusptot[x][y] = 0; NOT this line.
+              // now remove from proportion that can be eroded..
+              // we can do this as we have the prop (in temptot) that is there to be eroded.
+              double elevdiff = 0;
+              elevdiff = elev[x][y] - veg[x][y][0];
+              if (elevdiff < 0) elevdiff = 0;
+              double temptot3 = temptot1;
+              temptot1 = 0;
+              for (unsigned n = 1; n <= fractions; n++)
+              {
+                temp_dist[n] = elevdiff * (temp_dist[n] / temptot3);
+                if (elev[x][y] <= veg[x][y][0]) temp_dist[n] = 0;
+                temptot1 += temp_dist[n];
+              }
+              //temptot1 -= elevdiff;
+              if (temptot1 < 0) temptot1 = 0;
             }
           }
-          else
+
+          if (temptot1 > tempbmax)
           {
-            //else update grain and elevations for bedload.
-            double val1 = (su[x][y][n] + sr[x][y][n] + sd[x][y][n] + sl[x][y][n]);
-            double val2 = (su[x][y + 1][n] + sd[x][y - 1][n] + sl[x + 1][y][n] + sr[x - 1][y][n]);
-            grain[index[x][y]][n] += val2 - val1;
-            erodetot[x][y] += val2 - val1;
-            erodetot3[x][y] += val1;
+            tempbmax = temptot1;
           }
-        }
-
-        elev[x][y] += erodetot[x][y];
-        if (erodetot[x][y] < 0)
-        {
-          sort_active(x, y);
-        }
-        //
-        // test lateral code...
-        //
-
-        if (erodetot3[x][y] > 0)
-        {
-          double elev_update = 0;
 
-          if (elev[x - 1][y] > elev[x][y] && x > 2)
+          // now work out what goes where... the bedload is shared out
+          // between the neighbours by erosion_weight when erode() moves it
+          // only allow actual transfer of sediment if there is flow in a direction - i.e. some sedeiment transport
+          for (unsigned n = 1; n <= fractions; n++)
           {
-            double amt = 0;
-
-            if (water_depth[x - 1][y] < water_depth_erosion_threshold)
-            {
-              amt = mult_factor * lateral_constant * Tau[x][y] * edge[x - 1][y] * time_step /DX;
-            }
-            else
-            {
-              amt = chann_lateral_erosion * erodetot3[x][y] * (elev[x - 1][y] - elev[x][y]) / DX * 0.1;
-            }
-            if (amt > 0)
-            {
-              amt *= 1 - (veg[x - 1][y][1] * (1 - veg_lat_restriction));
-              if ((elev[x - 1][y] - amt) < bedrock[x - 1][y] || x - 1 == 1) amt = 0;
-              if (amt > ERODEFACTOR * 0.1) amt = ERODEFACTOR * 0.1;
-              //if (amt > erodetot2 / 2) amt = erodetot2 / 2;
-              elev_update += amt;
-              elev[x - 1][y] -= amt;
-              slide_GS(x - 1, y, amt, x, y);
-            }
+            const bool moves = temptot1 > 0 && temp_dist[n] > 0 &&
+                               !(n == 1 && opts.suspended);
+            bedload[x][y][n] = moves ? temp_dist[n] : 0;
           }
-          if (elev[x + 1][y] > elev[x][y] && x < imax-1)
+          if (opts.suspended && temptot1 > 0 && temp_dist[1] > 0)
           {
-            double amt = 0;
-            if (water_depth[x + 1][y] < water_depth_erosion_threshold)
-            {
-              amt = mult_factor * lateral_constant * Tau[x][y] * edge[x + 1][y] * time_step / DX;
-            }
-            else
+            for (int p = 1; p <= 8; p += 2)
             {
-              amt = chann_lateral_erosion * erodetot3[x][y] * (elev[x + 1][y] - elev[x][y]) / DX * 0.1;
-            }
-            if (amt > 0)
-            {
-              amt *= 1 - (veg[x + 1][y][1] * (1 - veg_lat_restriction));
-              if ((elev[x + 1][y] - amt) < bedrock[x + 1][y] || x + 1 == imax) amt = 0;
-              if (amt > ERODEFACTOR * 0.1) amt = ERODEFACTOR * 0.1;
-              //if (amt > erodetot2 /2) amt = erodetot2 /2;
-              elev_update += amt;
-              elev[x + 1][y] -= amt;
-              slide_GS(x + 1, y, amt, x, y);
+              if (water_depth[x + deltaX[p]][y + deltaY[p]] > water_depth_erosion_threshold)
+              {
+                // put amount entrained by ss in to ss[,]
+                ss[x][y] = temp_dist[1];
+                break;
+              }
             }
           }
-
-          elev[x][y] += elev_update;
         }
       }
     }
   }
+  return tempbmax;
+}
+
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+//
+// EROSION ROUTINE(S)
+//
+// This huge (sorry - will be refactored eventually!)
+// block of code does the erosion
+// in the model. It iterates over every cell
+// in the domain and calculates amounts to be
+// entrained into bedload and suspended load,
+// and the amount to erode or deposit. As you
+// may imagine, it's probably the most
+// compuationally expensive part of the code.
+// Especially when using multiple grain size
+// fracions.
+//
+// The Wilcock or Einstein models of sediment
+// transport can be used. Bedrock incision is
+// calculated using the simple stream power law.
+//
+// TO DO
+// It really ought to be split into smaller
+// functions, but it is what it is for now.
+//
+// Based on the erode function in CAESAR-Lisflood
+//
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-==-=
+double LSDCatchmentModel::erode(double mult_factor)
+{
+  double tempbmax = 0;
+
+  // Give the newly wetted cells their grain size records first
+  add_new_GS();
+  sediQ = 0;
+  erosion_calls++;
 
-#pragma omp parallel for
-  for (unsigned y = 2; y < jmax; ++y)
+  // Deal with erosion timestep
+  if (erode_timestep_type == 0)
   {
-    int inc = 1;
-    while (down_scan[y][inc] > 0)
+    // Erosion controls the global time step: it grows it, and cuts it
+    // back if any cell would erode too deep
+    time_step = time_step * 1.5;
+    erosion_step = time_step;
+    tempbmax = erode_step(mult_factor);
+    time_step = erosion_step;
+  }
+  else
+  {
+    // Erosion uses its own time step, and the global time step (and so
+    // the hydro time step) is not affected. It catches up with the model
+    // time since the last call, in as many steps as the erosion limit
+    // needs, or in one if it has skipped iterations (so mult_factor is not
+    // needed: the skipped time is in the time since the last call).
+    double remaining = (cycle - erosion_cycle) * 60;
+    erosion_cycle = cycle;
+    while (remaining > 0)
+    {
+      erosion_step_allowed = (erosion_step_allowed > 0) ?
+                             erosion_step_allowed * 1.5 : remaining;
+      if (max_time_step > 0 && erosion_step_allowed > max_time_step)
+      {
+        erosion_step_allowed = max_time_step;
+      }
+      // (the last step is only as long as the time left, which does not
+      // hold back the next call)
+      erosion_step = std::min(erosion_step_allowed, remaining);
+      const double tried = erosion_step;
+      tempbmax = std::max(tempbmax, erode_step(1.0));
+      if (erosion_step < tried) erosion_step_allowed = erosion_step;
+      remaining -= erosion_step;
+      erosion_substeps++;
+    }
+  }
+  return tempbmax;
+}
+
+// One step of erode(), over erosion_step * mult_factor seconds. Shortens
+// erosion_step until no cell erodes more than the erosion limit.
+//
+// With a morphological factor the bed changes that much faster than the
+// flow moves: the entrainment, deposition, bedrock, vegetation and bank
+// erosion are all multiplied by it, and so is the sediment output. The
+// suspended sediment in the water is not (the flow carries what it carries),
+// so the bed gives up morphological_factor times what goes into suspension,
+// and gains that many times what settles out. The erosion limit still holds
+// the (accelerated) bed change of each step to ERODEFACTOR.
+double LSDCatchmentModel::erode_step(double mult_factor)
+{
+  double tempbmax = 0;
+  float gtot2[20] = {};
+  const double morph_factor = mult_factor * morphological_factor;
+
+  // The rates do not depend on the time step, so a retry only scales them
+  // again
+  (this->*erosion_rates_kernel)();
+  do
+  {
+    tempbmax = (this->*erosion_transfers_kernel)(morph_factor);
+
+    if (tempbmax > ERODEFACTOR)
     {
-      unsigned x = down_scan[y][inc];
-      inc++;
+      erosion_step *= (ERODEFACTOR / tempbmax) * 0.5;
+    }
+  } while(tempbmax > ERODEFACTOR);
+
+  TNT::Array2D<double> erodetot(imax+2, jmax+2, 0.0);
+  TNT::Array2D<double> erodetot3(imax+2, jmax+2, 0.0);
+
+#pragma omp parallel for schedule(runtime)
+  for (int c = 0; c < column_work.chunks(); c++)
+  {
+    const int y_last = std::min(column_work.last(c), static_cast<int>(jmax) - 1);
+    for (int y = std::max(column_work.first(c), 2); y <= y_last; y++)
+    {
+      int inc = 1;
+      int eroding = 0;
+      while (down_scan[y][inc] > 0)
       {
-        if (erodetot3[x][y] > 0)
-        {
-          double elev_update = 0;
+        unsigned x = down_scan[y][inc];
+        inc++;
 
-          if (elev[x][y - 1] > elev[x][y])
+        if (water_depth[x][y] > water_depth_erosion_threshold && x < imax && x > 1)
+        {
+          for (unsigned int n = 1; n <= G_MAX-1; n++)
           {
-            double amt = 0;
-            if (water_depth[x][y - 1] < water_depth_erosion_threshold)
+            if (n == 1 && isSuspended[n])
             {
-              amt = mult_factor * lateral_constant * Tau[x][y] * edge[x][y - 1] * time_step / DX;
+              // updating entrainment of SS
+              Vsusptot[x][y] += ss[x][y] / morphological_factor;
+              grain[index[x][y]][n] -= ss[x][y];
+              erodetot[x][y] -= ss[x][y];
+
+              // this next part is unusual. You have to stop susp sed deposition on the input cells, otherwies
+              // it drops sediment out, but cannot entrain as ss levels in input are too high leading to
+              // little mountains of sediment. This means a new array in order to check whether a cell is an
+              // input point or not..
+              if (!inputpointsarray[x][y])
+              {
+                // now calc ss to be dropped
+                double coeff = (fallVelocity[n] * erosion_step) / water_depth[x][y];
+                if (coeff > 1) coeff = 1;
+                double Vpdrop = coeff * Vsusptot[x][y];
+                if (Vpdrop > 0.001) Vpdrop = 0.001; //only allow 1mm to be deposited per iteration
+                Vsusptot[x][y] -= Vpdrop;
+                Vpdrop *= morphological_factor;
+                grain[index[x][y]][n] += Vpdrop;
+                erodetot[x][y] += Vpdrop;
+                //if (Vsusptot[x][y] < 0) Vsusptot[x][y] = 0; NOT this line.
+              }
             }
             else
             {
-              amt = chann_lateral_erosion * erodetot3[x][y] * (elev[x][y - 1] - elev[x][y]) / DX *0.1;
-            }
-            if (amt > 0)
-            {
-              amt *= 1 - (veg[x][y - 1][1] * (1 - veg_lat_restriction));
-              if ((elev[x][y - 1] - amt) < bedrock[x][y - 1] || y - 1 == 1) amt = 0;
-              if (amt > ERODEFACTOR * 0.1) amt = ERODEFACTOR * 0.1;
-              //if (amt > erodetot2 / 2) amt = erodetot2 / 2;
-              elev_update += amt;
-              elev[x][y - 1] -= amt;
-              slide_GS(x, y - 1, amt, x, y);
+              //else update grain and elevations for bedload.
+              // What goes up, right, down and left, and what comes in
+              // from the neighbours on each side
+              const double out = bedload[x][y][n];
+              double val1 = (out * erosion_weight[x][y][0] + out * erosion_weight[x][y][1] +
+                             out * erosion_weight[x][y][2] + out * erosion_weight[x][y][3]);
+              double val2 = (bedload[x][y + 1][n] * erosion_weight[x][y + 1][0] +
+                             bedload[x][y - 1][n] * erosion_weight[x][y - 1][2] +
+                             bedload[x + 1][y][n] * erosion_weight[x + 1][y][3] +
+                             bedload[x - 1][y][n] * erosion_weight[x - 1][y][1]);
+              grain[index[x][y]][n] += val2 - val1;
+              erodetot[x][y] += val2 - val1;
+              erodetot3[x][y] += val1;
             }
           }
-          if (elev[x][y + 1] > elev[x][y])
-          {
-            double amt = 0;
-            if (water_depth[x][y + 1] < water_depth_erosion_threshold)
-            {
-              amt = mult_factor * lateral_constant * Tau[x][y] * edge[x][y + 1] * time_step / DX;
-            }
-            else
-            {
-              amt = chann_lateral_erosion * erodetot3[x][y] * (elev[x][y + 1] - elev[x][y]) / DX * 0.1;
-            }
 
-            if (amt > 0)
-            {
-              amt *= 1 - (veg[x][y + 1][1] * (1 - veg_lat_restriction));
-              if ((elev[x][y + 1] - amt) < bedrock[x][y + 1] || y + 1 == jmax) amt = 0;
-              if (amt > ERODEFACTOR * 0.1) amt = ERODEFACTOR * 0.1;
-              //if (amt > erodetot2 / 2) amt = erodetot2 / 2;
-              elev_update += amt;
-              elev[x][y + 1] -= amt;
-              slide_GS(x, y + 1, amt, x, y);
-            }
+          elev[x][y] += erodetot[x][y];
+          if (erodetot[x][y] != 0) note_height_change(x, y);
+          if (erodetot[x][y] < 0)
+          {
+            sort_active(x, y);
           }
-
-          elev[x][y] += elev_update;
+          if (erodetot3[x][y] > 0) eroding_cells[y][++eroding] = x;
         }
       }
+      eroding_cells[y][eroding + 1] = 0;
     }
   }
 
+  // Lateral erosion of the banks along x, then along y
+  lateral_erosion(1, 0, erodetot3, morph_factor);
+  lateral_erosion(0, 1, erodetot3, morph_factor);
 
 // now calculate sediment outputs from all four edges...
 #ifndef __INTEL_COMPILER   // OpenMP 4.5 array reduction not yet supported by intel
@@ -4761,12 +6731,12 @@ double LSDCatchmentModel::erode(double mult_factor)
       {
         if (isSuspended[n])
         {
-          gtot2[n] += Vsusptot[imax][y];
+          gtot2[n] += Vsusptot[imax][y] * morphological_factor;
           Vsusptot[imax][y] = 0;
         }
         else
         {
-          gtot2[n] += sr[imax - 1][y][n];
+          gtot2[n] += bedload[imax - 1][y][n] * erosion_weight[imax - 1][y][1];
         }
       }
     }
@@ -4776,12 +6746,12 @@ double LSDCatchmentModel::erode(double mult_factor)
       {
         if (isSuspended[n])
         {
-          gtot2[n] += Vsusptot[1][y];
+          gtot2[n] += Vsusptot[1][y] * morphological_factor;
           Vsusptot[1][y] = 0;
         }
         else
         {
-          gtot2[n] += sl[2][y][n];
+          gtot2[n] += bedload[2][y][n] * erosion_weight[2][y][3];
         }
       }
     }
@@ -4800,12 +6770,12 @@ double LSDCatchmentModel::erode(double mult_factor)
       {
         if (isSuspended[n])
         {
-          gtot2[n] += Vsusptot[x][jmax];
+          gtot2[n] += Vsusptot[x][jmax] * morphological_factor;
           Vsusptot[x][jmax] = 0;
         }
         else
         {
-          gtot2[n] += sd[x][jmax - 1][n];
+          gtot2[n] += bedload[x][jmax - 1][n] * erosion_weight[x][jmax - 1][2];
         }
       }
     }
@@ -4815,12 +6785,12 @@ double LSDCatchmentModel::erode(double mult_factor)
       {
         if (isSuspended[n])
         {
-          gtot2[n] += Vsusptot[x][1];
+          gtot2[n] += Vsusptot[x][1] * morphological_factor;
           Vsusptot[x][1] = 0;
         }
         else
         {
-          gtot2[n] += su[x][2][n];
+          gtot2[n] += bedload[x][2][n] * erosion_weight[x][2][0];
         }
       }
     }
@@ -4829,7 +6799,6 @@ double LSDCatchmentModel::erode(double mult_factor)
   /// now update files for outputing sediment and re-circulating...
   ///
 
-  sediQ = 0;
   for (unsigned int n = 1; n <= G_MAX; n++)
   {
     if (temp_grain[n] < 0) temp_grain[n] = 0;
@@ -5290,249 +7259,681 @@ void LSDCatchmentModel::lateral_channel_erode()
 
 }
 
+// The neighbours a cell sends hillslope material to, in the order
+// creep() always tested them
+static const int HILLSLOPE_DX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int HILLSLOPE_DY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
 void LSDCatchmentModel::creep(double time)
 {
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double creep_start = omp_get_wtime();
+  #endif
   // creep rate is 10*-2 * slope per year, so inputs time jump in years*/
-  // very important differnece here is that slide_GS() is called only if
-  //      BOTH cells are not -9999 therfore if both have grainsize then do additions.
-  //      this is to stop the progressive spread of selected cells upslope */
+  if (implicit_creep)
+  {
+    creep_cg_iterations += implicit_hillslope_diffusion(CREEP_RATE, time);
+  }
+  else
+  {
+    hillslope_transport(CREEP_RATE, time, false);
+  }
+  creep_steps++;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  creep_seconds += omp_get_wtime() - creep_start;
+  #endif
+}
+
+bool LSDCatchmentModel::hillslope_fluxes(int x, int y, double rate,
+                                         double time, bool area_weighted,
+                                         double* out)
+{
+  for (int n = 0; n < 8; n++) out[n] = -1;
+  // Only cells inside the edges send material
+  if (x < 2 || x > static_cast<int>(imax) - 1 ||
+      y < 2 || y > static_cast<int>(jmax) - 1) return false;
+  if (!(elev[x][y] > bedrock[x][y])) return false;
+
+  const double weight = area_weighted ? std::pow(area[x][y] * DX * DX, 0.5) : 1;
+  bool sends = false;
+  for (int n = 0; n < 8; n++)
+  {
+    const int x2 = x + HILLSLOPE_DX[n];
+    const int y2 = y + HILLSLOPE_DY[n];
+    if (!(elev[x2][y2] < elev[x][y] && elev[x2][y2] > -9999)) continue;
+
+    const double length = (HILLSLOPE_DX[n] != 0 && HILLSLOPE_DY[n] != 0) ? root : DX;
+    double temp = ((elev[x][y] - elev[x2][y2]) / length) * rate * time / length;
+    if (area_weighted) temp *= weight;
+    if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
+    if (temp < 0) temp = 0;
+    out[n] = temp;
+    sends = true;
+  }
+  return sends;
+}
 
-  unsigned  x,y;
-  double temp;
+void LSDCatchmentModel::hillslope_transport(double rate, double time,
+                                            bool area_weighted)
+{
+  // Every cell gives each lower neighbour an amount worked out from the
+  // elevations at the start (hillslope_fluxes()). These are worked out
+  // once, into hillslope_out, and each cell then gathers what it gives
+  // and gets into tempcreep, so the cells can be done in parallel. The
+  // terms are added in the order the cell used to see them when the
+  // cells scattered to their neighbours one after another (x, then y):
+  // those from the neighbours before it, its own, then those from the
+  // neighbours after it. The elevations come out the same, bit for bit.
+  static const int before[4] = { 7, 6, 5, 0 };
+  static const int after[4] = { 4, 1, 2, 3 };
+  start_hillslope_exchange();
+
+  // No data cells never creep or receive creep, so the tiles without
+  // data are skipped. Each thread takes one block of whole rows, so it
+  // works through contiguous memory.
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = span.first; y <= span.last; y++)
+      {
+        if (hillslope_fluxes(x, y, rate, time, area_weighted, hillslope_sent(x, y)))
+        {
+          hillslope_senders[x].push_back(y);
+        }
+      }
+    }
+  }
 
-  for(x=1;x<=imax;x++)
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
   {
-    for(y=1;y<=jmax;y++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
     {
-      tempcreep[x][y]=0;
+      for (int y = span.first; y <= span.last; y++)
+      {
+        const double* out = hillslope_sent(x, y);
+        double change = 0;
+        for (int k = 0; k < 4; k++)
+        {
+          const int n = before[k];
+          const double temp = hillslope_sent(x + HILLSLOPE_DX[n], y + HILLSLOPE_DY[n])[(n + 4) % 8];
+          if (temp >= 0) change += temp;
+        }
+        for (int n = 0; n < 8; n++)
+        {
+          if (out[n] >= 0) change -= out[n];
+        }
+        for (int k = 0; k < 4; k++)
+        {
+          const int n = after[k];
+          const double temp = hillslope_sent(x + HILLSLOPE_DX[n], y + HILLSLOPE_DY[n])[(n + 4) % 8];
+          if (temp >= 0) change += temp;
+        }
+        tempcreep[x][y] = change;
+      }
     }
   }
 
+  hillslope_grain_exchange();
 
-  for(x=2;x<imax;x++)
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
   {
-    for(y=2;y<jmax;y++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
     {
-      if(elev[x][y]>bedrock[x][y])
+      for (int y = span.first; y <= span.last; y++)
+      {
+        elev[x][y] += tempcreep[x][y];
+        if (tempcreep[x][y] != 0) note_height_change(x, y);
+      }
+    }
+  }
+}
+
+void LSDCatchmentModel::start_hillslope_exchange()
+{
+  // Cells no step writes (the outer rows and the no data tiles) keep
+  // the -1 they start with, so they send nothing.
+  const size_t cells = static_cast<size_t>(imax + 2) * (jmax + 2);
+  if (hillslope_out.size() != cells * 8)
+  {
+    hillslope_out.assign(cells * 8, -1.0);
+    hillslope_senders.assign(imax + 2, std::vector<int>());
+  }
+  for (size_t x = 0; x < hillslope_senders.size(); x++) hillslope_senders[x].clear();
+}
+
+void LSDCatchmentModel::hillslope_grain_exchange()
+{
+  // The grain sizes go with the material through slide_GS(), in the order
+  // creep() always moved them (x, then y, then the neighbours in turn), so
+  // each cell passes on the grain sizes it was sent by the cells before
+  // it. The grain size totals depend on that order, so this stays serial:
+  // one slide_GS() for every move out of a cell with a grain size record,
+  // whatever the number of threads. Only the cells listed as sending in
+  // hillslope_senders are visited. A cell without a record sends none, so
+  // the records do not spread upslope into cells that have never been
+  // worked by the flow.
+  for (int x = 2; x < static_cast<int>(imax); x++)
+  {
+    for (int y : hillslope_senders[x])
+    {
+      if (index[x][y] == -9999) continue;
+      const double* out = hillslope_sent(x, y);
+      for (int n = 0; n < 8; n++)
+      {
+        if (out[n] >= 0) slide_GS(x, y, out[n], x + HILLSLOPE_DX[n], y + HILLSLOPE_DY[n]);
+      }
+    }
+  }
+}
+
+int LSDCatchmentModel::implicit_hillslope_diffusion(double rate, double time)
+{
+  // Each pair of neighbours is kept once, by its cell with the lower x
+  // (or the lower y in the same column), as that cell's neighbour n = 1
+  // to 4.
+  const int stride = jmax + 2;
+  const size_t cells = static_cast<size_t>(imax + 2) * stride;
+  auto pair_at = [&](int x, int y, int n) -> size_t {
+    if (n >= 1 && n <= 4) return (static_cast<size_t>(x) * stride + y) * 4 + n - 1;
+    return (static_cast<size_t>(x + HILLSLOPE_DX[n]) * stride + y + HILLSLOPE_DY[n]) * 4
+           + (n + 4) % 8 - 1;
+  };
+  // Whether hillslope_fluxes() lets the cell send material
+  auto sends_any = [&](int x, int y) {
+    return x >= 2 && x <= static_cast<int>(imax) - 1 &&
+           y >= 2 && y <= static_cast<int>(jmax) - 1 &&
+           elev[x][y] > bedrock[x][y];
+  };
+
+  // 1. A pair exchanges material if its higher cell could send the other
+  // some in hillslope_fluxes() (or either could, if they are level), at
+  // rate * time / distance^2 per metre of difference in height.
+  std::vector<double> conductance(cells * 4, 0.0);
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = span.first; y <= span.last; y++)
       {
-        if(elev[x][y-1]<elev[x][y]&&elev[x][y-1]> -9999)
+        if (!(elev[x][y] > -9999)) continue;
+        for (int n = 1; n <= 4; n++)
         {
-          temp = ((elev[x][y] - elev[x][y-1]) / DX) * CREEP_RATE * time / DX;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x][y-1]+=temp;
-          if(index[x][y]!=-9999)
-          {
-            slide_GS(x, y, temp, x, y - 1);
-          }
+          const int x2 = x + HILLSLOPE_DX[n];
+          const int y2 = y + HILLSLOPE_DY[n];
+          if (x2 > static_cast<int>(imax) || y2 < 1 || y2 > static_cast<int>(jmax) ||
+              !(elev[x2][y2] > -9999)) continue;
+          bool exchanges;
+          if (elev[x][y] > elev[x2][y2]) exchanges = sends_any(x, y);
+          else if (elev[x][y] < elev[x2][y2]) exchanges = sends_any(x2, y2);
+          else exchanges = sends_any(x, y) || sends_any(x2, y2);
+          if (!exchanges) continue;
+          const double length = (HILLSLOPE_DX[n] != 0 && HILLSLOPE_DY[n] != 0) ? root : DX;
+          conductance[pair_at(x, y, n)] = rate * time / (length * length);
         }
-        if(elev[x+1][y-1]<elev[x][y]&&elev[x+1][y-1]> -9999)
+      }
+    }
+  }
+
+  // 2. Backward Euler: the change d in the elevations z solves
+  // d = L(z + d), L being the sum of conductance * (neighbour - cell)
+  // over the pairs, i.e. (I - L) d = L(z). I - L is symmetric positive
+  // definite, so the conjugate gradient solves it, with the diagonal as
+  // the preconditioner. The dot products are summed column by column, so
+  // they do not depend on the threads. The loops hand each thread one
+  // block of whole rows, the same block on every pass.
+  std::vector<double> change(cells, 0.0), residual(cells, 0.0),
+    preconditioned(cells, 0.0), direction(cells, 0.0), product(cells, 0.0),
+    diagonal(cells, 1.0);
+  std::vector<double> column_sums(imax + 2, 0.0);
+  auto dot = [&](const std::vector<double>& a, const std::vector<double>& b) {
+    #pragma omp parallel for schedule(static)
+    for (int x = 1; x <= static_cast<int>(imax); x++)
+    {
+      double sum = 0;
+      for (const LSDColumnSpan& span : tiles.valid_spans(x))
+      {
+        for (int y = span.first; y <= span.last; y++)
         {
-          temp=((elev[x][y]-elev[x+1][y-1])/ root)*CREEP_RATE*time/ root;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x+1][y-1]+=temp;
-          if(index[x][y]!=-9999)
-          {
-            slide_GS(x, y, temp, x+1, y - 1);
-          }
+          sum += a[x * stride + y] * b[x * stride + y];
+        }
+      }
+      column_sums[x] = sum;
+    }
+    double total = 0;
+    for (unsigned x = 1; x <= imax; x++) total += column_sums[x];
+    return total;
+  };
 
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = span.first; y <= span.last; y++)
+      {
+        const int c = x * stride + y;
+        double explicit_change = 0;
+        for (int n = 0; n < 8; n++)
+        {
+          const double g = conductance[pair_at(x, y, n)];
+          if (g == 0) continue;
+          explicit_change += g * (elev[x + HILLSLOPE_DX[n]][y + HILLSLOPE_DY[n]] - elev[x][y]);
+          diagonal[c] += g;
         }
-        if(elev[x+1][y]<elev[x][y]&&elev[x+1][y]> -9999)
+        residual[c] = explicit_change;
+        preconditioned[c] = residual[c] / diagonal[c];
+        direction[c] = preconditioned[c];
+      }
+    }
+  }
+
+  double rz = dot(residual, preconditioned);
+  double rr = dot(residual, residual);
+  const double stop = rr * 1e-20;  // until |residual| < 1e-10 |L(z)|
+  int iterations = 0;
+  while (rr > stop && iterations < 10000)
+  {
+    #pragma omp parallel for schedule(static)
+    for (int x = 1; x <= static_cast<int>(imax); x++)
+    {
+      for (const LSDColumnSpan& span : tiles.valid_spans(x))
+      {
+        for (int y = span.first; y <= span.last; y++)
         {
-          temp=((elev[x][y]-elev[x+1][y])/ DX)*CREEP_RATE*time/ DX;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x+1][y]+=temp;
-          if(index[x][y]!=-9999)
+          const int c = x * stride + y;
+          double sum = diagonal[c] * direction[c];
+          for (int n = 0; n < 8; n++)
           {
-            slide_GS(x, y, temp, x+1, y);
+            const double g = conductance[pair_at(x, y, n)];
+            if (g != 0) sum -= g * direction[(x + HILLSLOPE_DX[n]) * stride + y + HILLSLOPE_DY[n]];
           }
+          product[c] = sum;
         }
-        if(elev[x+1][y+1]<elev[x][y]&&elev[x+1][y+1]> -9999)
+      }
+    }
+    const double alpha = rz / dot(direction, product);
+    #pragma omp parallel for schedule(static)
+    for (int x = 1; x <= static_cast<int>(imax); x++)
+    {
+      for (const LSDColumnSpan& span : tiles.valid_spans(x))
+      {
+        for (int y = span.first; y <= span.last; y++)
         {
-          temp=((elev[x][y]-elev[x+1][y+1])/ root)*CREEP_RATE*time/ root;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x+1][y+1]+=temp;
-          if(index[x][y]!=-9999)
-          {
-            slide_GS(x, y, temp, x+1, y + 1);
-          }
+          const int c = x * stride + y;
+          change[c] += alpha * direction[c];
+          residual[c] -= alpha * product[c];
+          preconditioned[c] = residual[c] / diagonal[c];
         }
-        if(elev[x][y+1]<elev[x][y]&&elev[x][y+1]> -9999)
+      }
+    }
+    const double rz_next = dot(residual, preconditioned);
+    rr = dot(residual, residual);
+    const double beta = rz_next / rz;
+    rz = rz_next;
+    #pragma omp parallel for schedule(static)
+    for (int x = 1; x <= static_cast<int>(imax); x++)
+    {
+      for (const LSDColumnSpan& span : tiles.valid_spans(x))
+      {
+        for (int y = span.first; y <= span.last; y++)
         {
-          temp=((elev[x][y]-elev[x][y+1])/ DX)*CREEP_RATE*time/ DX;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x][y+1]+=temp;
-          if(index[x][y]!=-9999)
-          {
-            slide_GS(x, y, temp, x, y + 1);
-          }
+          const int c = x * stride + y;
+          direction[c] = preconditioned[c] + beta * direction[c];
         }
-        if(elev[x-1][y+1]<elev[x][y]&&elev[x-1][y+1]> -9999)
+      }
+    }
+    iterations++;
+  }
+
+  // 3. What each pair moves at the new elevations (from the kept cell to
+  // its neighbour n if positive) goes in place of the conductance.
+  std::vector<double>& moved = conductance;
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = span.first; y <= span.last; y++)
+      {
+        for (int n = 1; n <= 4; n++)
         {
-          temp=((elev[x][y]-elev[x-1][y+1])/ root)*CREEP_RATE*time/ root;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x-1][y+1]+=temp;
-          if(index[x][y]!=-9999)
-          {
-            slide_GS(x, y, temp, x-1, y + 1);
-          }
+          const size_t k = pair_at(x, y, n);
+          if (conductance[k] == 0) continue;
+          const int x2 = x + HILLSLOPE_DX[n];
+          const int y2 = y + HILLSLOPE_DY[n];
+          moved[k] = conductance[k] * ((elev[x][y] + change[x * stride + y]) -
+                                       (elev[x2][y2] + change[x2 * stride + y2]));
         }
-        if(elev[x-1][y]<elev[x][y]&&elev[x-1][y]> -9999)
+      }
+    }
+  }
+  // Material cell (x, y) sends its neighbour n (negative if it gets some)
+  auto along = [&](int x, int y, int n) {
+    const double m = moved[pair_at(x, y, n)];
+    return (n >= 1 && n <= 4) ? m : -m;
+  };
+
+  // 4. The bedrock: a cell cannot send more than its soil and what it is
+  // sent, so each cell sends only a share of what the solve says. The
+  // shares of the cells that would go below their bedrock are cut to
+  // what they have, which cuts what their neighbours get, until no cell
+  // is cut any more. The cells on the edges send nothing, as in
+  // hillslope_fluxes().
+  std::vector<double> share(cells, 0.0), next_share(cells, 0.0);
+  #pragma omp parallel for schedule(static)
+  for (int x = 2; x < static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = std::max(span.first, 2); y <= std::min(span.last, static_cast<int>(jmax) - 1); y++)
+      {
+        if (elev[x][y] > -9999) share[x * stride + y] = 1;
+      }
+    }
+  }
+  for (int pass = 0; pass < 1000; pass++)
+  {
+    bool cut = false;
+    #pragma omp parallel for schedule(static) reduction(||:cut)
+    for (int x = 1; x <= static_cast<int>(imax); x++)
+    {
+      for (const LSDColumnSpan& span : tiles.valid_spans(x))
+      {
+        for (int y = span.first; y <= span.last; y++)
         {
-          temp=((elev[x][y]-elev[x-1][y])/ DX)*CREEP_RATE*time/ DX;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x-1][y]+=temp;
-          if(index[x][y]!=-9999)
+          const int c = x * stride + y;
+          double s = share[c];
+          if (s > 0)
           {
-            slide_GS(x, y, temp, x-1, y );
+            double sent = 0, got = 0;
+            for (int n = 0; n < 8; n++)
+            {
+              const double m = along(x, y, n);
+              if (m > 0) sent += m;
+              else if (m < 0) got -= m * share[(x + HILLSLOPE_DX[n]) * stride + y + HILLSLOPE_DY[n]];
+            }
+            const double soil = elev[x][y] - bedrock[x][y] + got;
+            if (sent * s > soil)
+            {
+              s = (soil > 0) ? soil / sent : 0;
+              if (s < share[c]) cut = true;
+            }
           }
+          next_share[c] = s;
         }
-        if(elev[x-1][y-1]<elev[x][y]&&elev[x-1][y-1]> -9999)
+      }
+    }
+    share.swap(next_share);
+    if (!cut) break;
+  }
+
+  // What each cell sends goes in hillslope_out, for the grain sizes
+  start_hillslope_exchange();
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
+  {
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
+    {
+      for (int y = span.first; y <= span.last; y++)
+      {
+        double* out = hillslope_sent(x, y);
+        bool sends = false;
+        double sum = 0;
+        for (int n = 0; n < 8; n++)
         {
-          temp=((elev[x][y]-elev[x-1][y-1])/ root)*CREEP_RATE*time/ root;
-          if((elev[x][y]-temp)<bedrock[x][y])temp=elev[x][y]-bedrock[x][y];
-          if(temp<0)temp=0;
-          tempcreep[x][y]-=temp;
-          tempcreep[x-1][y-1]+=temp;
-          if(index[x][y]!=-9999)
+          const double m = along(x, y, n);
+          out[n] = -1;
+          if (m > 0)
           {
-            slide_GS(x, y, temp, x-1, y - 1);
+            const double sent = m * share[x * stride + y];
+            sum -= sent;
+            if (sent > 0)
+            {
+              out[n] = sent;
+              sends = true;
+            }
           }
+          else if (m < 0) sum -= m * share[(x + HILLSLOPE_DX[n]) * stride + y + HILLSLOPE_DY[n]];
         }
+        tempcreep[x][y] = sum;
+        if (sends) hillslope_senders[x].push_back(y);
       }
     }
   }
 
-  for(x=1;x<=imax;x++)
+  hillslope_grain_exchange();
+
+  #pragma omp parallel for schedule(static)
+  for (int x = 1; x <= static_cast<int>(imax); x++)
   {
-    for(y=1;y<=jmax;y++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
     {
-      elev[x][y]+=tempcreep[x][y];
+      for (int y = span.first; y <= span.last; y++)
+      {
+        elev[x][y] += tempcreep[x][y];
+        if (tempcreep[x][y] != 0) note_height_change(x, y);
+      }
     }
   }
+  return iterations;
+}
 
+// The neighbours of a cell in the order the landslide routines test them
+static const int LANDSLIDE_DX[8] = { 1, 0, -1, -1, -1, 0, 1, 1 };
+static const int LANDSLIDE_DY[8] = { 1, 1, 1, 0, -1, -1, -1, 0 };
+
+bool LSDCatchmentModel::in_channel_slide_cell(int x, int y, double factor)
+{
+  double wet_factor = factor;
+  //if(water_depth[x][y]>0.01)wet_factor=factor/2;
+  // check to see if under water
+  if (elev[x][y] <= (bedrock[x][y] + active)) wet_factor = 10000;
+
+  // chexk landslides in channel slowly
+  bool moved = false;
+  for (int n = 0; n < 8; n++)
+  {
+    const int x2 = x + LANDSLIDE_DX[n];
+    const int y2 = y + LANDSLIDE_DY[n];
+    double drop = elev[x][y] - elev[x2][y2];
+    if (LANDSLIDE_DX[n] != 0 && LANDSLIDE_DY[n] != 0) drop /= 1.41;
+    if (drop > wet_factor && elev[x2][y2] > -9999)
+    {
+      double diff = drop - wet_factor;
+      if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
+      elev[x][y] -= diff;
+      elev[x2][y2] += diff;
+      note_height_change(x, y);
+      note_height_change(x2, y2);
+      slide_GS(x, y, diff, x2, y2);
+      moved = true;
+    }
+  }
+  return moved;
 }
 
 void LSDCatchmentModel::in_channel_landsliding()
 {
-  unsigned x,y,inc;
-  double wet_factor;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double landslide_start = omp_get_wtime();
+  #endif
   // This is a runtime constant, calculated every function call..!
   double factor=std::tan((failureangle*(3.141592654/180)))*DX;
-  double diff=0;
 
-  for(y=2;y<jmax;y++)
+  if (!coloured_channel_landsliding)
   {
-
-    inc=1;
-    // Only do on wetted cells and their neigbours
-    while(down_scan[y][inc]>0)
+    for (unsigned y = 2; y < jmax; y++)
     {
-
-      x=down_scan[y][inc];
-      if(x==imax)x=imax-1;
-      if(x==1)x=2;
-
-      inc++;
-      // check to see if under water
-      wet_factor=factor;
-      //if(water_depth[x][y]>0.01)wet_factor=factor/2;
-      if(elev[x][y]<=(bedrock[x][y]+active))wet_factor=10000;
-
-      // chexk landslides in channel slowly
-
-      if(((elev[x][y]-elev[x+1][y+1])/1.41)>wet_factor&&elev[x+1][y+1]> -9999)
-      {
-        diff=((elev[x][y]-elev[x+1][y+1])/1.41)-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x+1][y+1]+=diff;
-        slide_GS(x,y,diff,x+1,y+1);
-      }
-      if((elev[x][y]-elev[x][y+1])>wet_factor&&elev[x][y+1]> -9999)
-      {
-        diff=(elev[x][y]-elev[x][y+1])-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x][y+1]+=diff;
-        slide_GS(x,y,diff,x,y+1);
-      }
-      if(((elev[x][y]-elev[x-1][y+1])/1.41)>wet_factor&&elev[x-1][y+1]> -9999)
-      {
-        diff=((elev[x][y]-elev[x-1][y+1])/1.41)-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x-1][y+1]+=diff;
-        slide_GS(x,y,diff,x-1,y+1);
-      }
-      if((elev[x][y]-elev[x-1][y])>wet_factor&&elev[x-1][y]> -9999)
+      unsigned inc = 1;
+      // Only do on wetted cells and their neigbours
+      while (down_scan[y][inc] > 0)
       {
-        diff=(elev[x][y]-elev[x-1][y])-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x-1][y]+=diff;
-        slide_GS(x,y,diff,x-1,y);
+        unsigned x = down_scan[y][inc];
+        if (x == imax) x = imax - 1;
+        if (x == 1) x = 2;
+        inc++;
+        in_channel_slide_cell(x, y, factor);
       }
+    }
+    #ifdef OMP_COMPILE_FOR_PARALLEL
+    channel_landslide_seconds += omp_get_wtime() - landslide_start;
+    #endif
+    return;
+  }
 
-      if(((elev[x][y]-elev[x-1][y-1])/1.41)>wet_factor&&elev[x-1][y-1]> -9999)
-      {
-        diff=((elev[x][y]-elev[x-1][y-1])/1.41)-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x-1][y-1]+=diff;
-        slide_GS(x,y,diff,x-1,y-1);
-      }
-      if((elev[x][y]-elev[x][y-1])>wet_factor&&elev[x][y-1]> -9999)
-      {
-        diff=(elev[x][y]-elev[x][y-1])-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x][y-1]+=diff;
-        slide_GS(x,y,diff,x,y-1);
-      }
-      if(((elev[x][y]-elev[x+1][y-1])/1.41)>wet_factor&&elev[x+1][y-1]> -9999)
+  // A cell only changes itself and its eight neighbours, so the cells of
+  // columns three apart never touch the same cell. The columns are split
+  // into three colours by y % 3 (y = 2, 5, 8, ..., then 3, 6, 9, ...,
+  // then 4, 7, 10, ...), and the columns of each colour are done in
+  // parallel, each by one thread in the usual order. The result depends
+  // on the colour order but not on the number of threads.
+  const int row = jmax + 2;
+  std::vector<std::vector<int> > new_records(jmax + 2);
+  for (int y_first = 2; y_first <= 4; y_first++)
+  {
+    const int n_columns = (static_cast<int>(jmax) - y_first + 2) / 3;
+    const int first_slot = grain_array_tot;
+
+    #pragma omp parallel for schedule(runtime)
+    for (int c = 0; c < n_columns; c++)
+    {
+      const int y = y_first + 3 * c;
+      std::vector<int>& found = new_records[y];
+      found.clear();
+      int inc = 1;
+      while (down_scan[y][inc] > 0)
       {
-        diff=((elev[x][y]-elev[x+1][y-1])/1.41)-wet_factor;
-        if((elev[x][y]-diff)<(bedrock[x][y]+active))diff=(elev[x][y]-(bedrock[x][y]+active));
-        elev[x][y]-=diff;
-        elev[x+1][y-1]+=diff;
-        slide_GS(x,y,diff,x+1,y-1);
+        int x = down_scan[y][inc];
+        if (x == static_cast<int>(imax)) x = imax - 1;
+        if (x == 1) x = 2;
+        inc++;
+        if (!in_channel_slide_cell(x, y, factor)) continue;
+
+        // Note the records slide_GS() gave to the cell or its neighbours
+        for (int y2 = y - 1; y2 <= y + 1; y2++)
+        {
+          for (int x2 = x - 1; x2 <= x + 1; x2++)
+          {
+            if (index[x2][y2] > first_slot &&
+                std::find(found.begin(), found.end(), x2 * row + y2) == found.end())
+            {
+              found.push_back(x2 * row + y2);
+            }
+          }
+        }
       }
+    }
 
-      if ((elev[x][y] - elev[x + 1][y]) > wet_factor && elev[x + 1][y] > -9999)
+    // The threads took the slots of the new records in whatever order
+    // they got to them: number them column by column instead
+    if (grain_array_tot > first_slot)
+    {
+      std::vector<int> cells;
+      for (int c = 0; c < n_columns; c++)
       {
-        diff = (elev[x][y] - elev[x + 1][y]) - wet_factor;
-        if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-        elev[x][y] -= diff;
-        elev[x + 1][y] += diff;
-        slide_GS(x, y, diff, x + 1, y);
+        const std::vector<int>& found = new_records[y_first + 3 * c];
+        cells.insert(cells.end(), found.begin(), found.end());
       }
-
+      renumber_records(cells, first_slot);
     }
   }
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  channel_landslide_seconds += omp_get_wtime() - landslide_start;
+  #endif
+}
+
+void LSDCatchmentModel::renumber_records(const std::vector<int>& cells,
+                                         int first_slot)
+{
+  const int row = jmax + 2;
+  const int grain_length = grain.record_length();
+  const int strata_length = strata.record_length();
+  std::vector<double> grain_copy(cells.size() * grain_length);
+  std::vector<double> strata_copy(cells.size() * strata_length);
+  for (size_t k = 0; k < cells.size(); k++)
+  {
+    const int slot = index[cells[k] / row][cells[k] % row];
+    std::copy(grain.record(slot), grain.record(slot) + grain_length,
+              grain_copy.begin() + k * grain_length);
+    std::copy(strata.record(slot), strata.record(slot) + strata_length,
+              strata_copy.begin() + k * strata_length);
+  }
+  for (size_t k = 0; k < cells.size(); k++)
+  {
+    const int slot = first_slot + 1 + static_cast<int>(k);
+    index[cells[k] / row][cells[k] % row] = slot;
+    std::copy(grain_copy.begin() + k * grain_length,
+              grain_copy.begin() + (k + 1) * grain_length, grain.record(slot));
+    std::copy(strata_copy.begin() + k * strata_length,
+              strata_copy.begin() + (k + 1) * strata_length, strata.record(slot));
+  }
+}
+
+bool LSDCatchmentModel::slope_unstable(int x, int y, double factor)
+{
+  // The same tests as slide_cell(), without moving anything
+  const double wet_factor = (elev[x][y] <= (bedrock[x][y] + active)) ? 10 * DX : factor;
+  const double here = elev[x][y];
+  return (((here - elev[x + 1][y + 1]) / 1.41) > wet_factor && elev[x + 1][y + 1] > -9999)
+      || ((here - elev[x][y + 1]) > wet_factor && elev[x][y + 1] > -9999)
+      || (((here - elev[x - 1][y + 1]) / 1.41) > wet_factor && elev[x - 1][y + 1] > -9999)
+      || ((here - elev[x - 1][y]) > wet_factor && elev[x - 1][y] > -9999)
+      || (((here - elev[x - 1][y - 1]) / 1.41) > wet_factor && elev[x - 1][y - 1] > -9999)
+      || ((here - elev[x][y - 1]) > wet_factor && elev[x][y - 1] > -9999)
+      || (((here - elev[x + 1][y - 1]) / 1.41) > wet_factor && elev[x + 1][y - 1] > -9999)
+      || ((here - elev[x + 1][y]) > wet_factor && elev[x + 1][y] > -9999);
+}
+
+void LSDCatchmentModel::note_height_change(int x, int y)
+{
+  if (!landslide_worklist || landslide_changed[x][y]) return;
+  landslide_changed[x][y] = 1;
+  int thread = 0;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  thread = omp_get_thread_num();
+  #endif
+  landslide_changed_cells[thread].push_back(x * (jmax + 2) + y);
+}
+
+bool LSDCatchmentModel::slide_cell(int x, int y, double factor, double& total)
+{
+  double wet_factor = factor;
+  if (elev[x][y] <= (bedrock[x][y] + active)) wet_factor = 10 * DX;
 
+  bool moved = false;
+  for (int n = 0; n < 8; n++)
+  {
+    const int x2 = x + LANDSLIDE_DX[n];
+    const int y2 = y + LANDSLIDE_DY[n];
+    double drop = elev[x][y] - elev[x2][y2];
+    if (LANDSLIDE_DX[n] != 0 && LANDSLIDE_DY[n] != 0) drop /= 1.41;
+    if (drop > wet_factor && elev[x2][y2] > -9999)
+    {
+      double diff = drop - wet_factor;
+      if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
+      if (diff > ERODEFACTOR) diff = ERODEFACTOR;
+      elev[x][y] -= diff;
+      elev[x2][y2] += diff;
+      total += diff;
+      moved = true;
+    }
+  }
+  return moved;
 }
 
 void LSDCatchmentModel::global_landsliding()
 {
   unsigned x, y, inc=0;
-  double wet_factor;
   double factor = std::tan((failureangle * (3.141592654 / 180))) * DX;
-  double diff = 0;
   double total = 0;
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  double landslide_start = omp_get_wtime();
+  #endif
 
   if (dunes_opt == true)
   {
@@ -5545,247 +7946,173 @@ void LSDCatchmentModel::global_landsliding()
     }
   }
 
-
-  do
+  if (!landslide_worklist)
   {
-    total = 0;
-    inc++;
-    for (x = 2; x < imax; x++)
+    do
     {
-      for (y = 2; y < jmax; y++)
+      total = 0;
+      inc++;
+      for (x = 2; x < imax; x++)
       {
-
-        wet_factor = factor;
-        if (elev[x][y] <= (bedrock[x][y] + active)) wet_factor = 10 * DX;
-
-        // chexk landslides in channel slowly
-
-        if (((elev[x][y] - elev[x + 1][y + 1]) / 1.41) > wet_factor && elev[x + 1][y + 1]> -9999)
-        {
-          diff = ((elev[x][y] - elev[x + 1][y + 1]) / 1.41) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x + 1][y + 1] += diff;
-          total += diff;
-        }
-        if ((elev[x][y] - elev[x][y + 1]) > wet_factor && elev[x][y + 1]> -9999)
-        {
-          diff = (elev[x][y] - elev[x][y + 1]) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x][y + 1] += diff;
-          total += diff;
-        }
-        if (((elev[x][y] - elev[x - 1][y + 1]) / 1.41) > wet_factor && elev[x - 1][y + 1]> -9999)
-        {
-          diff = ((elev[x][y] - elev[x - 1][y + 1]) / 1.41) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x - 1][y + 1] += diff;
-          total += diff;
-        }
-        if ((elev[x][y] - elev[x - 1][y]) > wet_factor && elev[x - 1][y]> -9999)
-        {
-          diff = (elev[x][y] - elev[x - 1][y]) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x - 1][y] += diff;
-          total += diff;
-        }
-
-        if (((elev[x][y] - elev[x - 1][y - 1]) / 1.41) > wet_factor && elev[x - 1][y - 1]> -9999)
-        {
-          diff = ((elev[x][y] - elev[x - 1][y - 1]) / 1.41) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x - 1][y - 1] += diff;
-          total += diff;
-        }
-        if ((elev[x][y] - elev[x][y - 1]) > wet_factor && elev[x][y - 1]> -9999)
-        {
-          diff = (elev[x][y] - elev[x][y - 1]) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x][y - 1] += diff;
-          total += diff;
-        }
-        if (((elev[x][y] - elev[x + 1][y - 1]) / 1.41) > wet_factor && elev[x + 1][y - 1]> -9999)
+        for (y = 2; y < jmax; y++)
         {
-          diff = ((elev[x][y] - elev[x + 1][y - 1]) / 1.41) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x + 1][y - 1] += diff;
-          total += diff;
+          slide_cell(x, y, factor, total);
         }
-
-
-
-        if ((elev[x][y] - elev[x + 1][y]) > wet_factor && elev[x + 1][y]> -9999)
+      }
+      landslide_cell_visits += static_cast<long long>(imax - 2) * (jmax - 2);
+    } while (total > 0 && inc<200);
+  }
+  else
+  {
+    // The sweeps below visit the cells in the same order as the full
+    // sweeps above, but skip the ones that cannot move anything: a cell
+    // that was stable when last tested stays stable until it or one of
+    // its neighbours changes height. When a cell slides, it and the
+    // neighbours it dropped material on change, so every cell within two
+    // of it is queued again: in this sweep if the full sweep has yet to
+    // reach it, otherwise in the next one. The results are the same as
+    // the full sweeps, bit for bit.
+    //
+    // The queued cells are flagged, and each row keeps the range of
+    // columns holding its flags, so a sweep only scans those ranges.
+    const int row = jmax + 2;
+    const int first = 2, last_x = imax - 1, last_y = jmax - 1;
+    std::vector<unsigned char> queued((imax + 2) * row, 0);
+    std::vector<unsigned char> queued_next((imax + 2) * row, 0);
+    std::vector<int> lo(imax + 2, INT_MAX), hi(imax + 2, -1);
+    std::vector<int> lo_next(imax + 2, INT_MAX), hi_next(imax + 2, -1);
+
+    // The cells that are unstable to start with. Every cell was stable at
+    // the end of the last call, and stays so until it or a neighbour
+    // changes height or bedrock. The routines that change them note the
+    // cells (note_height_change()), so only those and their neighbours are
+    // tested, and nothing at all if none changed. The first call tests
+    // every cell, and so does every call with dunes, as the sand taken off
+    // above changes between calls.
+    if (landslide_seed_all || dunes_opt)
+    {
+      #pragma omp parallel for schedule(static)
+      for (int i = first; i <= last_x; i++)
+      {
+        for (int j = first; j <= last_y; j++)
         {
-          diff = (elev[x][y] - elev[x + 1][y]) - wet_factor;
-          if ((elev[x][y] - diff) < (bedrock[x][y] + active)) diff = (elev[x][y] - (bedrock[x][y] + active));
-          if (diff > ERODEFACTOR) diff = ERODEFACTOR;
-          elev[x][y] -= diff;
-          elev[x + 1][y] += diff;
-          total += diff;
+          if (slope_unstable(i, j, factor))
+          {
+            queued[i * row + j] = 1;
+            lo[i] = std::min(lo[i], j);
+            hi[i] = std::max(hi[i], j);
+          }
         }
-
       }
+      landslide_cell_visits += static_cast<long long>(imax - 2) * (jmax - 2);
+      landslide_seed_all = false;
     }
-  } while (total > 0 && inc<200);
-
-  if (dunes_opt == true)
-  {
-    for (x = 1; x <= imax; x++)
+    else
     {
-      for (y = 1; y <= jmax; y++)
+      for (size_t t = 0; t < landslide_changed_cells.size(); t++)
       {
-        elev[x][y] += sand[x][y];
+        for (size_t k = 0; k < landslide_changed_cells[t].size(); k++)
+        {
+          const int cx = landslide_changed_cells[t][k] / row;
+          const int cy = landslide_changed_cells[t][k] % row;
+          for (int i = std::max(cx - 1, first); i <= std::min(cx + 1, last_x); i++)
+          {
+            for (int j = std::max(cy - 1, first); j <= std::min(cy + 1, last_y); j++)
+            {
+              if (queued[i * row + j]) continue;
+              landslide_cell_visits++;
+              if (slope_unstable(i, j, factor))
+              {
+                queued[i * row + j] = 1;
+                lo[i] = std::min(lo[i], j);
+                hi[i] = std::max(hi[i], j);
+              }
+            }
+          }
+        }
       }
     }
-  }
-}
-
-void LSDCatchmentModel::soil_erosion(double time)
-{
-  // creep rate is 10*-2 * slope per year, so inputs time jump in years*/
-  // very important differnece here is that slide_GS() is called only if
-  //      BOTH cells are not -9999 therfore if both have grainsize then do additions.
-  //      this is to stop the progressive spread of selected cells upslope */
-
-  unsigned x, y;
-  double temp;
-
-
-  for (x = 1; x <= jmax; x++)
-  {
-    for (y = 1; y <= imax; y++)
+    for (size_t t = 0; t < landslide_changed_cells.size(); t++)
     {
-      tempcreep[x][y] = 0;
+      for (size_t k = 0; k < landslide_changed_cells[t].size(); k++)
+      {
+        const int c = landslide_changed_cells[t][k];
+        landslide_changed[c / row][c % row] = 0;
+      }
+      landslide_changed_cells[t].clear();
     }
-  }
 
-  for (x = 2; x < jmax; x++)
-  {
-    for (y = 2; y < imax; y++)
+    do
     {
-      if (elev[x][y] > bedrock[x][y])
+      total = 0;
+      inc++;
+      for (int i = first; i <= last_x; i++)
       {
-        if (elev[x][y - 1] < elev[x][y] && elev[x][y - 1] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x][y - 1]) / DX) * SOIL_RATE * time / DX * std::pow(area[x][y]*DX*DX,0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x][y - 1] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x, y - 1);
-          }
-        }
-        if (elev[x + 1][y - 1] < elev[x][y] && elev[x + 1][y - 1] > -9999)
+        // hi[i] can grow as the cells before (i, j) slide
+        for (int j = lo[i]; j <= hi[i]; j++)
         {
-          temp = ((elev[x][y] - elev[x + 1][y - 1]) / root) * SOIL_RATE * time / root * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x + 1][y - 1] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x + 1, y - 1);
-          }
+          if (!queued[i * row + j]) continue;
+          queued[i * row + j] = 0;
+          landslide_cell_visits++;
+          if (!slide_cell(i, j, factor, total)) continue;
 
-        }
-        if (elev[x + 1][y] < elev[x][y] && elev[x + 1][y] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x + 1][y]) / DX) * SOIL_RATE * time / DX * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x + 1][y] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x + 1, y);
-          }
-        }
-        if (elev[x + 1][y + 1] < elev[x][y] && elev[x + 1][y + 1] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x + 1][y + 1]) / root) * SOIL_RATE * time / root * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x + 1][y + 1] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x + 1, y + 1);
-          }
-        }
-        if (elev[x][y + 1] < elev[x][y] && elev[x][y + 1] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x][y + 1]) / DX) * SOIL_RATE * time / DX * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x][y + 1] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x, y + 1);
-          }
-        }
-        if (elev[x - 1][y + 1] < elev[x][y] && elev[x - 1][y + 1] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x - 1][y + 1]) / root) * SOIL_RATE * time / root * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x - 1][y + 1] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x - 1, y + 1);
-          }
-        }
-        if (elev[x - 1][y] < elev[x][y] && elev[x - 1][y] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x - 1][y]) / DX) * SOIL_RATE * time / DX * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x - 1][y] += temp;
-          if (index[x][y] != -9999)
-          {
-            slide_GS(x, y, temp, x - 1, y);
-          }
-        }
-        if (elev[x - 1][y - 1] < elev[x][y] && elev[x - 1][y - 1] > -9999)
-        {
-          temp = ((elev[x][y] - elev[x - 1][y - 1]) / root) * SOIL_RATE * time / root * std::pow(area[x][y] * DX * DX, 0.5);
-          if ((elev[x][y] - temp) < bedrock[x][y]) temp = elev[x][y] - bedrock[x][y];
-          if (temp < 0) temp = 0;
-          tempcreep[x][y] -= temp;
-          tempcreep[x - 1][y - 1] += temp;
-          if (index[x][y] != -9999)
+          for (int i2 = std::max(i - 2, first); i2 <= std::min(i + 2, last_x); i2++)
           {
-            slide_GS(x, y, temp, x - 1, y - 1);
+            for (int j2 = std::max(j - 2, first); j2 <= std::min(j + 2, last_y); j2++)
+            {
+              if (i2 > i || (i2 == i && j2 > j))
+              {
+                queued[i2 * row + j2] = 1;
+                lo[i2] = std::min(lo[i2], j2);
+                hi[i2] = std::max(hi[i2], j2);
+              }
+              else
+              {
+                queued_next[i2 * row + j2] = 1;
+                lo_next[i2] = std::min(lo_next[i2], j2);
+                hi_next[i2] = std::max(hi_next[i2], j2);
+              }
+            }
           }
         }
+        lo[i] = INT_MAX;
+        hi[i] = -1;
+      }
+      queued.swap(queued_next);
+      lo.swap(lo_next);
+      hi.swap(hi_next);
+    } while (total > 0 && inc<200);
+
+    // If the sweeps ran out, the cells still queued are tested next time
+    for (int i = first; total > 0 && i <= last_x; i++)
+    {
+      for (int j = lo[i]; j <= hi[i]; j++)
+      {
+        if (queued[i * row + j]) note_height_change(i, j);
       }
     }
   }
+  landslide_sweeps += inc;
 
-  for (unsigned x = 1; x <= jmax; x++)
+  if (dunes_opt == true)
   {
-    for (unsigned y = 1; y <= imax; y++)
+    for (x = 1; x <= imax; x++)
     {
-      elev[x][y] += tempcreep[x][y];
+      for (y = 1; y <= jmax; y++)
+      {
+        elev[x][y] += sand[x][y];
+      }
     }
   }
+  #ifdef OMP_COMPILE_FOR_PARALLEL
+  landslide_seconds += omp_get_wtime() - landslide_start;
+  #endif
+}
+
+void LSDCatchmentModel::soil_erosion(double time)
+{
+  // Creep that grows with the square root of the drainage area
+  hillslope_transport(SOIL_RATE, time, true);
 }
 
 // all based on Van Walleghem et al., 2013 (JGR:ES)
@@ -5806,6 +8133,7 @@ void LSDCatchmentModel::soil_development()
             double h = elev[x][y] - bedrock[x][y];
             if (h == 0) h = 0.001;
             bedrock[x][y] += - P1 * std::exp(-b1 * (h)) / 12; //  / 12 to make it months
+            note_height_change(x, y);
           }
         }
 
@@ -5821,18 +8149,7 @@ void LSDCatchmentModel::soil_development()
           {
             if ((grain[xyindex][n] > 0.0))
             {
-              switch (n)
-              {
-                case 1: Di = d1; break;
-                case 2: Di = d2; break;
-                case 3: Di = d3; break;
-                case 4: Di = d4; break;
-                case 5: Di = d5; break;
-                case 6: Di = d6; break;
-                case 7: Di = d7; break;
-                case 8: Di = d8; break;
-                case 9: Di = d9; break;
-              }
+              Di = grain_sizes[n];
 
               double amount = grain[xyindex][n] * ((-(k1 * std::exp(-c1 * active * 0.5) * (c2 / std::log(Di * 0.001)) * 1)) / 12); //  / 12 to make it months
               grain[xyindex][n] -= amount;
@@ -5846,7 +8163,7 @@ void LSDCatchmentModel::soil_development()
                 grain[xyindex][n - 2] += amount * 0.95;
               }
 
-              for (int z = 1; z <= 9; z++)
+              for (int z = 1; z < static_cast<int>(strata_layers); z++)
               {
                 // What is this actually needed for? check original implementation
                 double amount2 = strata[xyindex][z - 1][n] * ((-(k1 * std::exp(-c1 * active * z) * (c2 / std::log(Di * 0.001)) * 1)) / 12); //  / 12 to make it months
@@ -5877,78 +8194,82 @@ void LSDCatchmentModel::soil_development()
 
 void LSDCatchmentModel::grow_grass(double amount3)
 {
+  // There is no vegetation to grow in the no data tiles
   for(unsigned x=1; x<=imax; x++)
   {
-    for(unsigned y=1; y<=jmax; y++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(x))
     {
-      //first check if veg is at 0.. not sure if this is needed now..
-      if (veg[x][y][0] == 0)
-      {
-          veg[x][y][0] = elev[x][y];
-      }
-
-      // first check if under water or not..
-      if (water_depth[x][y] < water_depth_erosion_threshold)
+      for (int y = span.first; y <= span.last; y++)
       {
-        // if not then it
-        // now adds to the amount of veg there..
-        veg[x][y][1] += amount3;
-
-        if(veg[x][y][1] > 1)
+        //first check if veg is at 0.. not sure if this is needed now..
+        if (veg[x][y][0] == 0)
         {
-          veg[x][y][1] = 1;
+            veg[x][y][0] = elev[x][y];
         }
-      }
 
-      // check if veg below elev! if so raise to elev
-      if (veg[x][y][0] < elev[x][y]) // raises the veg level if it gets buried.. but only by a certain amount (0.001m day...)
-      {
-        veg[x][y][0] += 0.001; // this is an arbitrary amount..
-        if (veg[x][y][0] > elev[x][y]) veg[x][y][0] = elev[x][y];
-      }
+        // first check if under water or not..
+        if (water_depth[x][y] < water_depth_erosion_threshold)
+        {
+          // if not then it
+          // now adds to the amount of veg there..
+          veg[x][y][1] += amount3;
 
-      // check if veg above elev! if so lower to elev
-      if (veg[x][y][0] > elev[x][y])
-      {
-        veg[x][y][0] -= 0.001; // this is an arbitrary amount..
-        if (veg[x][y][0] < elev[x][y]) veg[x][y][0] = elev[x][y];
-      }
+          if(veg[x][y][1] > 1)
+          {
+            veg[x][y][1] = 1;
+          }
+        }
 
-      // trying to see now, if veg is above elev - so if lateral erosion happens - more than 0.1m the veg gets wiped..
+        // check if veg below elev! if so raise to elev
+        if (veg[x][y][0] < elev[x][y]) // raises the veg level if it gets buried.. but only by a certain amount (0.001m day...)
+        {
+          veg[x][y][0] += 0.001; // this is an arbitrary amount..
+          if (veg[x][y][0] > elev[x][y]) veg[x][y][0] = elev[x][y];
+        }
 
-      if (veg[x][y][0] - elev[x][y] > 0.1)
-      {
-        veg[x][y][1] = 0;
-        veg[x][y][0] = elev[x][y];
-      }
+        // check if veg above elev! if so lower to elev
+        if (veg[x][y][0] > elev[x][y])
+        {
+          veg[x][y][0] -= 0.001; // this is an arbitrary amount..
+          if (veg[x][y][0] < elev[x][y]) veg[x][y][0] = elev[x][y];
+        }
 
-      // now see if veg under water - if so let it die back a bit..
-      if(water_depth[x][y] > water_depth_erosion_threshold && veg[x][y][1] > 0)
-      {
-        veg[x][y][1] -= (amount3 / 2);
-        if (veg[x][y][1] < 0)
+        // trying to see now, if veg is above elev - so if lateral erosion happens - more than 0.1m the veg gets wiped..
+
+        if (veg[x][y][0] - elev[x][y] > 0.1)
         {
           veg[x][y][1] = 0;
-          veg[x][y][0] = elev[x][y]; // resets elev if veg amt is 0
+          veg[x][y][0] = elev[x][y];
         }
-      }
 
-      // also if it is under sediment - then dies back a bit too...
-      if (veg[x][y][0] < elev[x][y])
-      {
-        veg[x][y][1] -= (amount3 / 2);
-        if (veg[x][y][1] < 0)
+        // now see if veg under water - if so let it die back a bit..
+        if(water_depth[x][y] > water_depth_erosion_threshold && veg[x][y][1] > 0)
         {
-          veg[x][y][1] = 0;
-          veg[x][y][0] = elev[x][y]; // resets elev if veg amt is 0
+          veg[x][y][1] -= (amount3 / 2);
+          if (veg[x][y][1] < 0)
+          {
+            veg[x][y][1] = 0;
+            veg[x][y][0] = elev[x][y]; // resets elev if veg amt is 0
+          }
         }
-      }
 
-      // but if it is under sediment, has died back to nearly 0 (0.05) then it resets the elevation
-      // to the surface elev.
-      if (veg[x][y][0] < elev[x][y] && veg[x][y][1] < 0.05)
-      {
-        veg[x][y][0] = elev[x][y];
+        // also if it is under sediment - then dies back a bit too...
+        if (veg[x][y][0] < elev[x][y])
+        {
+          veg[x][y][1] -= (amount3 / 2);
+          if (veg[x][y][1] < 0)
+          {
+            veg[x][y][1] = 0;
+            veg[x][y][0] = elev[x][y]; // resets elev if veg amt is 0
+          }
+        }
+
+        // but if it is under sediment, has died back to nearly 0 (0.05) then it resets the elevation
+        // to the surface elev.
+        if (veg[x][y][0] < elev[x][y] && veg[x][y][1] < 0.05)
+        {
+          veg[x][y][0] = elev[x][y];
+        }
       }
     }
   }
@@ -5964,7 +8285,9 @@ void LSDCatchmentModel::wpgw_water_input()
   double flow_timestep = get_flow_timestep();
   for (unsigned i = 1; i <= imax; i++)
   {
-      for (unsigned j = 1; j <= jmax; j++)
+    for (const LSDColumnSpan& span : tiles.valid_spans(i))
+    {
+      for (int j = span.first; j <= span.last; j++)
       {
           if (elev[i][j] > -9999) // ensure it is not a no-data point
           {   
@@ -5972,6 +8295,7 @@ void LSDCatchmentModel::wpgw_water_input()
               if (groundwater_basic)
               {
                   water_depth[i][j] += flow_timestep * (dailyBF[i][j] / 86400); //#BGS add baseflow (scale to timestep) 
+                  if (dailyBF[i][j] > 0) note_water_added(i, j);
               }
               // poss restrict water input if numerical instablity. // tom investigate why its time factor not local_time_factor
 
@@ -5979,9 +8303,11 @@ void LSDCatchmentModel::wpgw_water_input()
               if (groundwater_SLiM)
               {
                   water_depth[i][j] += flow_timestep * (WP_added_water_daily[i][j] / 86400); //#BGS add or remove from water partition  (scale to timestep) 
+                  if (WP_added_water_daily[i][j] > 0) note_water_added(i, j);
               }    
           }
       }
+    }
   }
 }
 
@@ -6241,15 +8567,12 @@ void LSDCatchmentModel::print_parameters()
   {
     std::cout << "~~~~~~GRAIN SIZE DETAILS~~~~~~~" << std::endl;
     std::cout << "| PROP |" << " SIZE |" << "| FALL VELOCITY   |" << std::endl;
-    std::cout << dprop[1] << " | " << d1 << " | " << fallVelocity[1] << std::endl;
-    std::cout << dprop[2] << " | " << d2 << " | " << fallVelocity[2] << std::endl;
-    std::cout << dprop[3] << " | " << d3 << " | " << fallVelocity[3] << std::endl;
-    std::cout << dprop[4] << " | " << d4 << " | " << fallVelocity[4] << std::endl;
-    std::cout << dprop[5] << " | " << d5 << " | " << fallVelocity[5] << std::endl;
-    std::cout << dprop[6] << " | " << d6 << " | " << fallVelocity[6] << std::endl;
-    std::cout << dprop[7] << " | " << d7 << " | " << fallVelocity[7] << std::endl;
-    std::cout << dprop[8] << " | " << d8 << " | " << fallVelocity[8] << std::endl;
-    std::cout << dprop[9] << " | " << d9 << " | " << fallVelocity[9] << std::endl;
+    for (unsigned n = 1; n <= G_MAX - 1; n++)
+    {
+      std::cout << dprop[n] << " | " << grain_sizes[n] << " | "
+                << fallVelocity[n] << std::endl;
+    }
+    std::cout << "STRATA LAYERS:                 " << strata_layers << std::endl;
 
     std::cout << "SEDIMENT LAW:                  ";
       if (einstein) std::cout << "Einstein" << std::endl;
@@ -0,0 +1,320 @@
+// LSDFlowKernels.cpp
+
+/*
+ * Vectorised LISFLOOD face discharge kernels, see LSDFlowKernels.hpp.
+ *
+ * Each kernel is a lane-for-lane translation of the x (or y) block of
+ * LSDCatchmentModel::route_cell_flow(). Every "if" of the scalar code is
+ * evaluated for all lanes as a mask, and the result is blended in, in the
+ * same order as the scalar code applies it. The functions are compiled for
+ * their instruction set with the GCC target attribute, so the rest of the
+ * model does not need to be built with -mavx2 or -mavx512f.
+ *
+ * Released under the GNU v2 Public License
+ */
+
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define LSD_X86_KERNELS
+#endif
+
+#include "catchmentmodel/LSDFlowKernels.hpp"
+
+namespace LSDFlowKernels
+{
+
+#ifdef LSD_X86_KERNELS
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// AVX2: four cells per vector, masks are all-ones lanes of a __m256d
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+__attribute__((target("avx2")))
+void lisflood_face_avx2(const LSDFaceSpan& span, const LSDFaceParams& params)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d four = _mm256_set1_pd(4.0);
+  const __m256d five = _mm256_set1_pd(5.0);
+  const __m256d nodata = _mm256_set1_pd(-9999.0);
+  const __m256d sign_bit = _mm256_set1_pd(-0.0);
+  const __m256d g = _mm256_set1_pd(params.gravity);
+  const __m256d dt = _mm256_set1_pd(params.flow_timestep);
+  const __m256d dx = _mm256_set1_pd(params.DX);
+  const __m256d threshold = _mm256_set1_pd(params.hflow_threshold);
+  const __m256d froude = _mm256_set1_pd(params.froude_limit);
+  const __m256d fixed_slope = _mm256_set1_pd(params.slope);
+  const __m256d uniform_n = _mm256_set1_pd(params.mannings);
+
+  for (int i = 0; i < span.count; i += 4)
+  {
+    // Lanes past the end of the span are masked off loads and stores
+    const int remaining = span.count - i;
+    const __m256i tail = _mm256_cmpgt_epi64(
+        _mm256_set1_epi64x(remaining), _mm256_set_epi64x(3, 2, 1, 0));
+
+    const __m256d e = _mm256_maskload_pd(span.elev + i, tail);
+    const __m256d w = _mm256_maskload_pd(span.depth + i, tail);
+    const __m256d e_nb = _mm256_maskload_pd(span.elev_nb + i, tail);
+    const __m256d w_nb = _mm256_maskload_pd(span.depth_nb + i, tail);
+    const __m256d q_old = _mm256_maskload_pd(span.q + i, tail);
+    __m256d n = uniform_n;
+    if (span.mannings) n = _mm256_maskload_pd(span.mannings + i, tail);
+
+    // Which faces are looked at at all: real cells on both sides with
+    // water on at least one of them.
+    __m256d active = _mm256_and_pd(
+        _mm256_and_pd(_mm256_cmp_pd(e, nodata, _CMP_GT_OQ),
+                      _mm256_cmp_pd(e_nb, nodata, _CMP_GT_OQ)),
+        _mm256_or_pd(_mm256_cmp_pd(w, zero, _CMP_GT_OQ),
+                     _mm256_cmp_pd(w_nb, zero, _CMP_GT_OQ)));
+    active = _mm256_and_pd(active, _mm256_castsi256_pd(tail));
+
+    const __m256d surface = _mm256_add_pd(e, w);
+    const __m256d surface_nb = _mm256_add_pd(e_nb, w_nb);
+    const __m256d hflow = _mm256_sub_pd(_mm256_max_pd(surface, surface_nb),
+                                        _mm256_max_pd(e_nb, e));
+    const __m256d flowing = _mm256_and_pd(active,
+        _mm256_cmp_pd(hflow, threshold, _CMP_GT_OQ));
+
+    __m256d slope = _mm256_div_pd(_mm256_sub_pd(surface_nb, surface), dx);
+    if (params.fixed_slope) slope = fixed_slope;
+
+    // Semi-implicit friction update (Bates et al. 2010)
+    const __m256d g_h_dt = _mm256_mul_pd(_mm256_mul_pd(g, hflow), dt);
+    const __m256d h_cubed = _mm256_mul_pd(_mm256_mul_pd(hflow, hflow), hflow);
+    const __m256d abs_q = _mm256_andnot_pd(sign_bit, q_old);
+    __m256d q = _mm256_div_pd(
+        _mm256_sub_pd(q_old, _mm256_mul_pd(g_h_dt, slope)),
+        _mm256_add_pd(one, _mm256_div_pd(
+            _mm256_mul_pd(_mm256_mul_pd(g_h_dt, _mm256_mul_pd(n, n)), abs_q),
+            h_cubed)));
+
+    // Froude number limiter
+    const __m256d celerity = _mm256_sqrt_pd(_mm256_mul_pd(g, hflow));
+    const __m256d q_froude = _mm256_mul_pd(hflow,
+                                           _mm256_mul_pd(celerity, froude));
+    __m256d froude_num = _mm256_div_pd(_mm256_div_pd(q, hflow), celerity);
+    __m256d clip = _mm256_and_pd(_mm256_cmp_pd(q, zero, _CMP_GT_OQ),
+                                 _mm256_cmp_pd(froude_num, froude, _CMP_GT_OQ));
+    q = _mm256_blendv_pd(q, q_froude, clip);
+    froude_num = _mm256_div_pd(
+        _mm256_andnot_pd(sign_bit, _mm256_div_pd(q, hflow)), celerity);
+    clip = _mm256_and_pd(_mm256_cmp_pd(q, zero, _CMP_LT_OQ),
+                         _mm256_cmp_pd(froude_num, froude, _CMP_GT_OQ));
+    q = _mm256_blendv_pd(q, _mm256_sub_pd(zero, q_froude), clip);
+
+    // Do not move more than a quarter of the upwind cell in one step
+    __m256d moved = _mm256_div_pd(_mm256_mul_pd(q, dt), dx);
+    clip = _mm256_and_pd(_mm256_cmp_pd(q, zero, _CMP_GT_OQ),
+                         _mm256_cmp_pd(moved, _mm256_div_pd(w, four), _CMP_GT_OQ));
+    q = _mm256_blendv_pd(q,
+          _mm256_div_pd(_mm256_div_pd(_mm256_mul_pd(w, dx), five), dt), clip);
+    moved = _mm256_andnot_pd(sign_bit,
+                             _mm256_div_pd(_mm256_mul_pd(q, dt), dx));
+    clip = _mm256_and_pd(_mm256_cmp_pd(q, zero, _CMP_LT_OQ),
+                         _mm256_cmp_pd(moved, _mm256_div_pd(w_nb, four), _CMP_GT_OQ));
+    q = _mm256_blendv_pd(q, _mm256_sub_pd(zero,
+          _mm256_div_pd(_mm256_div_pd(_mm256_mul_pd(w_nb, dx), five), dt)), clip);
+
+    const __m256d q_pos = _mm256_cmp_pd(q, zero, _CMP_GT_OQ);
+    const __m256d q_neg = _mm256_cmp_pd(q, zero, _CMP_LT_OQ);
+
+    // Suspended sediment flux, carried at the upwind concentration
+    const __m256d qs_old = _mm256_maskload_pd(span.qs + i, tail);
+    __m256d qs = qs_old;
+    if (params.suspended)
+    {
+      const __m256d v = _mm256_maskload_pd(span.susp + i, tail);
+      const __m256d v_nb = _mm256_maskload_pd(span.susp_nb + i, tail);
+      qs = _mm256_blendv_pd(qs, _mm256_mul_pd(q, _mm256_div_pd(v, w)), q_pos);
+      qs = _mm256_blendv_pd(qs, _mm256_mul_pd(q, _mm256_div_pd(v_nb, w_nb)), q_neg);
+
+      const __m256d v_dx = _mm256_mul_pd(v, dx);
+      const __m256d v_nb_dx = _mm256_mul_pd(v_nb, dx);
+      const __m256d qs_dt = _mm256_mul_pd(qs, dt);
+      clip = _mm256_and_pd(_mm256_cmp_pd(qs, zero, _CMP_GT_OQ),
+                           _mm256_cmp_pd(qs_dt, _mm256_div_pd(v_dx, four), _CMP_GT_OQ));
+      qs = _mm256_blendv_pd(qs, _mm256_div_pd(_mm256_div_pd(v_dx, five), dt), clip);
+      clip = _mm256_and_pd(_mm256_cmp_pd(qs, zero, _CMP_LT_OQ),
+                           _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, _mm256_mul_pd(qs, dt)),
+                                         _mm256_div_pd(v_nb_dx, four), _CMP_GT_OQ));
+      qs = _mm256_blendv_pd(qs, _mm256_sub_pd(zero,
+             _mm256_div_pd(_mm256_div_pd(v_nb_dx, five), dt)), clip);
+    }
+
+    // Faces that are active but too shallow to flow are zeroed, inactive
+    // faces keep their old values.
+    q = _mm256_blendv_pd(zero, q, flowing);
+    q = _mm256_blendv_pd(q_old, q, active);
+    qs = _mm256_blendv_pd(zero, qs, flowing);
+    qs = _mm256_blendv_pd(qs_old, qs, active);
+
+    _mm256_maskstore_pd(span.q + i, tail, q);
+    _mm256_maskstore_pd(span.qs + i, tail, qs);
+    _mm256_maskstore_pd(span.hflow_out + i, tail,
+                        _mm256_blendv_pd(zero, hflow, flowing));
+  }
+}
+
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// AVX-512: eight cells per vector, masks live in k registers
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+__attribute__((target("avx512f")))
+void lisflood_face_avx512(const LSDFaceSpan& span, const LSDFaceParams& params)
+{
+  const __m512d zero = _mm512_setzero_pd();
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d four = _mm512_set1_pd(4.0);
+  const __m512d five = _mm512_set1_pd(5.0);
+  const __m512d nodata = _mm512_set1_pd(-9999.0);
+  const __m512d g = _mm512_set1_pd(params.gravity);
+  const __m512d dt = _mm512_set1_pd(params.flow_timestep);
+  const __m512d dx = _mm512_set1_pd(params.DX);
+  const __m512d threshold = _mm512_set1_pd(params.hflow_threshold);
+  const __m512d froude = _mm512_set1_pd(params.froude_limit);
+  const __m512d fixed_slope = _mm512_set1_pd(params.slope);
+  const __m512d uniform_n = _mm512_set1_pd(params.mannings);
+  // The unmasked max and sqrt pass an undefined vector through as their
+  // source, which GCC warns about, so they are done masked on every lane
+  // with zero as the source.
+  const __mmask8 all = 0xFF;
+
+  for (int i = 0; i < span.count; i += 8)
+  {
+    const int remaining = span.count - i;
+    const __mmask8 tail = (remaining >= 8) ? 0xFF
+                          : static_cast<__mmask8>((1u << remaining) - 1);
+
+    const __m512d e = _mm512_maskz_loadu_pd(tail, span.elev + i);
+    const __m512d w = _mm512_maskz_loadu_pd(tail, span.depth + i);
+    const __m512d e_nb = _mm512_maskz_loadu_pd(tail, span.elev_nb + i);
+    const __m512d w_nb = _mm512_maskz_loadu_pd(tail, span.depth_nb + i);
+    const __m512d q_old = _mm512_maskz_loadu_pd(tail, span.q + i);
+    const __m512d qs_old = _mm512_maskz_loadu_pd(tail, span.qs + i);
+    __m512d n = uniform_n;
+    if (span.mannings) n = _mm512_maskz_loadu_pd(tail, span.mannings + i);
+
+    const __mmask8 active = tail
+      & _mm512_cmp_pd_mask(e, nodata, _CMP_GT_OQ)
+      & _mm512_cmp_pd_mask(e_nb, nodata, _CMP_GT_OQ)
+      & (_mm512_cmp_pd_mask(w, zero, _CMP_GT_OQ)
+         | _mm512_cmp_pd_mask(w_nb, zero, _CMP_GT_OQ));
+
+    const __m512d surface = _mm512_add_pd(e, w);
+    const __m512d surface_nb = _mm512_add_pd(e_nb, w_nb);
+    const __m512d hflow = _mm512_sub_pd(_mm512_mask_max_pd(zero, all, surface, surface_nb),
+                                        _mm512_mask_max_pd(zero, all, e_nb, e));
+    const __mmask8 flowing = active
+      & _mm512_cmp_pd_mask(hflow, threshold, _CMP_GT_OQ);
+
+    __m512d slope = _mm512_div_pd(_mm512_sub_pd(surface_nb, surface), dx);
+    if (params.fixed_slope) slope = fixed_slope;
+
+    const __m512d g_h_dt = _mm512_mul_pd(_mm512_mul_pd(g, hflow), dt);
+    const __m512d h_cubed = _mm512_mul_pd(_mm512_mul_pd(hflow, hflow), hflow);
+    __m512d q = _mm512_div_pd(
+        _mm512_sub_pd(q_old, _mm512_mul_pd(g_h_dt, slope)),
+        _mm512_add_pd(one, _mm512_div_pd(
+            _mm512_mul_pd(_mm512_mul_pd(g_h_dt, _mm512_mul_pd(n, n)),
+                          _mm512_abs_pd(q_old)),
+            h_cubed)));
+
+    const __m512d celerity = _mm512_mask_sqrt_pd(zero, all, _mm512_mul_pd(g, hflow));
+    const __m512d q_froude = _mm512_mul_pd(hflow,
+                                           _mm512_mul_pd(celerity, froude));
+    __mmask8 clip = _mm512_cmp_pd_mask(q, zero, _CMP_GT_OQ)
+      & _mm512_cmp_pd_mask(_mm512_div_pd(_mm512_div_pd(q, hflow), celerity),
+                           froude, _CMP_GT_OQ);
+    q = _mm512_mask_mov_pd(q, clip, q_froude);
+    clip = _mm512_cmp_pd_mask(q, zero, _CMP_LT_OQ)
+      & _mm512_cmp_pd_mask(_mm512_div_pd(_mm512_abs_pd(_mm512_div_pd(q, hflow)),
+                                         celerity),
+                           froude, _CMP_GT_OQ);
+    q = _mm512_mask_mov_pd(q, clip, _mm512_sub_pd(zero, q_froude));
+
+    clip = _mm512_cmp_pd_mask(q, zero, _CMP_GT_OQ)
+      & _mm512_cmp_pd_mask(_mm512_div_pd(_mm512_mul_pd(q, dt), dx),
+                           _mm512_div_pd(w, four), _CMP_GT_OQ);
+    q = _mm512_mask_mov_pd(q, clip,
+          _mm512_div_pd(_mm512_div_pd(_mm512_mul_pd(w, dx), five), dt));
+    clip = _mm512_cmp_pd_mask(q, zero, _CMP_LT_OQ)
+      & _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_div_pd(_mm512_mul_pd(q, dt), dx)),
+                           _mm512_div_pd(w_nb, four), _CMP_GT_OQ);
+    q = _mm512_mask_mov_pd(q, clip, _mm512_sub_pd(zero,
+          _mm512_div_pd(_mm512_div_pd(_mm512_mul_pd(w_nb, dx), five), dt)));
+
+    __m512d qs = qs_old;
+    if (params.suspended)
+    {
+      const __m512d v = _mm512_maskz_loadu_pd(tail, span.susp + i);
+      const __m512d v_nb = _mm512_maskz_loadu_pd(tail, span.susp_nb + i);
+      qs = _mm512_mask_mov_pd(qs, _mm512_cmp_pd_mask(q, zero, _CMP_GT_OQ),
+                              _mm512_mul_pd(q, _mm512_div_pd(v, w)));
+      qs = _mm512_mask_mov_pd(qs, _mm512_cmp_pd_mask(q, zero, _CMP_LT_OQ),
+                              _mm512_mul_pd(q, _mm512_div_pd(v_nb, w_nb)));
+
+      const __m512d v_dx = _mm512_mul_pd(v, dx);
+      const __m512d v_nb_dx = _mm512_mul_pd(v_nb, dx);
+      clip = _mm512_cmp_pd_mask(qs, zero, _CMP_GT_OQ)
+        & _mm512_cmp_pd_mask(_mm512_mul_pd(qs, dt),
+                             _mm512_div_pd(v_dx, four), _CMP_GT_OQ);
+      qs = _mm512_mask_mov_pd(qs, clip,
+                              _mm512_div_pd(_mm512_div_pd(v_dx, five), dt));
+      clip = _mm512_cmp_pd_mask(qs, zero, _CMP_LT_OQ)
+        & _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_mul_pd(qs, dt)),
+                             _mm512_div_pd(v_nb_dx, four), _CMP_GT_OQ);
+      qs = _mm512_mask_mov_pd(qs, clip, _mm512_sub_pd(zero,
+             _mm512_div_pd(_mm512_div_pd(v_nb_dx, five), dt)));
+    }
+
+    // Active faces that do not flow are zeroed; inactive ones are left alone
+    const __mmask8 dry = active & static_cast<__mmask8>(~flowing);
+    _mm512_mask_storeu_pd(span.q + i, flowing, q);
+    _mm512_mask_storeu_pd(span.q + i, dry, zero);
+    _mm512_mask_storeu_pd(span.qs + i, flowing, qs);
+    _mm512_mask_storeu_pd(span.qs + i, dry, zero);
+    _mm512_mask_storeu_pd(span.hflow_out + i, tail,
+                          _mm512_maskz_mov_pd(flowing, hflow));
+  }
+}
+
+#else
+
+void lisflood_face_avx2(const LSDFaceSpan&, const LSDFaceParams&) {}
+void lisflood_face_avx512(const LSDFaceSpan&, const LSDFaceParams&) {}
+
+#endif
+
+LSDFaceKernel select_face_kernel(const std::string& requested,
+                                 std::string& chosen)
+{
+  bool has_avx2 = false;
+  bool has_avx512 = false;
+  #ifdef LSD_X86_KERNELS
+  __builtin_cpu_init();
+  has_avx2 = __builtin_cpu_supports("avx2");
+  has_avx512 = __builtin_cpu_supports("avx512f");
+  #endif
+
+  if (requested == "avx2" && has_avx2)
+  {
+    chosen = "avx2";
+    return lisflood_face_avx2;
+  }
+  if (requested != "avx2" && has_avx512)
+  {
+    chosen = "avx512";
+    return lisflood_face_avx512;
+  }
+  if (has_avx2)
+  {
+    chosen = "avx2";
+    return lisflood_face_avx2;
+  }
+  chosen = "scalar";
+  return NULL;
+}
+
+}
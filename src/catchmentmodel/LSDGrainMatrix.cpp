@@ -47,12 +47,14 @@
   exit(EXIT_FAILURE);
 }*/
 
-void LSDGrainMatrix::create(int imax, int jmax, int NoDataVal, int G_MAX)
+void LSDGrainMatrix::create(int imax, int jmax, int NoDataVal, int G_MAX,
+                            int strata_layers)
 {
   NRows = imax; // +2? -check in LSDCatchmentModel
   NCols = jmax;
   NoData = NoDataVal;
   GrainFracMax = G_MAX;
+  StrataLayers = strata_layers;
   std::cout << "Initialised a Grain Matrix..." << std::endl;
 }
 
@@ -94,7 +96,7 @@ void LSDGrainMatrix::write_grainMatrix_to_ascii_file(std::string filename,
           }
           
           // Now write the subsurface grain fractions
-          for(int z=0; z<=9; z++) // Loop through subsurface layers...
+          for(int z=0; z<StrataLayers; z++) // Loop through subsurface layers...
           {
             for(int inc=0; inc<=(GrainFracMax-2); inc++)
             {
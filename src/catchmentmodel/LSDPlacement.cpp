@@ -0,0 +1,186 @@
+// LSDPlacement.cpp
+
+/*
+ * Thread pinning and NUMA page placement queries, see LSDPlacement.hpp.
+ *
+ * Released under the GNU v2 Public License
+ */
+
+#include <omp.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#ifdef __GLIBC__
+  #include <malloc.h>
+#endif
+
+#ifdef __linux__
+  #include <sched.h>
+  #include <unistd.h>
+  #include <sys/syscall.h>
+  #define LSD_LINUX_PLACEMENT
+#endif
+
+#include "catchmentmodel/LSDPlacement.hpp"
+
+namespace LSDPlacement
+{
+
+bool parse_affinity(const std::string& name, LSDAffinityMode& mode_out)
+{
+  if (name == "none") mode_out = NO_AFFINITY;
+  else if (name == "close") mode_out = CLOSE_AFFINITY;
+  else if (name == "spread") mode_out = SPREAD_AFFINITY;
+  else return false;
+  return true;
+}
+
+std::string affinity_name(LSDAffinityMode mode)
+{
+  switch (mode)
+  {
+    case CLOSE_AFFINITY: return "close";
+    case SPREAD_AFFINITY: return "spread";
+    default: return "none";
+  }
+}
+
+bool pin_threads(LSDAffinityMode mode)
+{
+  if (mode == NO_AFFINITY) return true;
+  // There are only threads to pin in the OpenMP build
+  #if defined(LSD_LINUX_PLACEMENT) && defined(OMP_COMPILE_FOR_PARALLEL)
+  // The CPUs we may use, in order (e.g. those given by taskset or the
+  // batch system)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+  std::vector<int> cpus;
+  for (int c = 0; c < CPU_SETSIZE; c++)
+  {
+    if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+  }
+  const int n_cpus = static_cast<int>(cpus.size());
+  if (n_cpus == 0 || omp_get_max_threads() > n_cpus) return false;
+
+  bool pinned = true;
+  #pragma omp parallel reduction(&&:pinned)
+  {
+    const int t = omp_get_thread_num();
+    const int n_threads = omp_get_num_threads();
+    const int slot = (mode == SPREAD_AFFINITY) ?
+                     static_cast<int>(static_cast<long>(t) * n_cpus / n_threads) : t;
+    cpu_set_t mine;
+    CPU_ZERO(&mine);
+    CPU_SET(cpus[slot], &mine);
+    pinned = (sched_setaffinity(0, sizeof(mine), &mine) == 0);
+  }
+  return pinned;
+  #else
+  return false;
+  #endif
+}
+
+void use_fresh_pages()
+{
+  #ifdef __GLIBC__
+  // Setting the threshold also stops glibc from raising it as large
+  // blocks are freed
+  mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+  #endif
+}
+
+void current_cpu(int& cpu, int& node)
+{
+  cpu = -1;
+  node = -1;
+  #ifdef LSD_LINUX_PLACEMENT
+  unsigned c = 0, n = 0;
+  if (syscall(SYS_getcpu, &c, &n, NULL) == 0)
+  {
+    cpu = static_cast<int>(c);
+    node = static_cast<int>(n);
+  }
+  #endif
+}
+
+long page_size()
+{
+  #ifdef LSD_LINUX_PLACEMENT
+  return sysconf(_SC_PAGESIZE);
+  #else
+  return 4096;
+  #endif
+}
+
+bool page_nodes(const void* start, size_t bytes,
+                std::vector<long>& pages, long& unplaced)
+{
+  pages.clear();
+  unplaced = 0;
+  #ifdef LSD_LINUX_PLACEMENT
+  if (start == NULL || bytes == 0) return true;
+  const long page = page_size();
+  const size_t first = reinterpret_cast<size_t>(start) / page;
+  const size_t last = (reinterpret_cast<size_t>(start) + bytes - 1) / page;
+
+  // With no target nodes, move_pages only reports where each page is
+  const size_t BATCH = 1024;
+  std::vector<void*> addresses(BATCH);
+  std::vector<int> status(BATCH);
+  for (size_t p = first; p <= last; p += BATCH)
+  {
+    const size_t count = std::min(BATCH, last - p + 1);
+    for (size_t i = 0; i < count; i++)
+    {
+      addresses[i] = reinterpret_cast<void*>((p + i) * page);
+    }
+    if (syscall(SYS_move_pages, 0, count, &addresses[0], NULL,
+                &status[0], 0) != 0) return false;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (status[i] < 0)
+      {
+        unplaced++;
+        continue;
+      }
+      if (status[i] >= static_cast<int>(pages.size())) pages.resize(status[i] + 1, 0);
+      pages[status[i]]++;
+    }
+  }
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+std::string describe_placement(const void* start, size_t bytes)
+{
+  std::vector<long> pages;
+  long unplaced = 0;
+  if (!page_nodes(start, bytes, pages, unplaced)) return "unknown";
+
+  long total = unplaced;
+  for (size_t n = 0; n < pages.size(); n++) total += pages[n];
+  if (total == 0) return "empty";
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  for (size_t n = 0; n < pages.size(); n++)
+  {
+    if (pages[n] == 0) continue;
+    if (out.tellp() > 0) out << ", ";
+    out << "node " << n << ": " << 100.0 * pages[n] / total << "%";
+  }
+  if (unplaced > 0)
+  {
+    if (out.tellp() > 0) out << ", ";
+    out << "not placed: " << 100.0 * unplaced / total << "%";
+  }
+  return out.str();
+}
+
+}
@@ -22,6 +22,20 @@
 #include "catchmentmodel/LSDRainfallRunoff.hpp"
 #include "topotools/LSDRaster.hpp"
 
+// LSDRaster only takes double arrays, and the grids here are hydro_real
+static TNT::Array2D<double> to_double_array(const TNT::Array2D<hydro_real>& in)
+{
+  TNT::Array2D<double> out(in.dim1(), in.dim2());
+  for (int i = 0; i < in.dim1(); i++)
+  {
+    for (int j = 0; j < in.dim2(); j++)
+    {
+      out[i][j] = in[i][j];
+    }
+  }
+  return out;
+}
+
 void rainGrid::create()
 {
   std::cout << "You have tried to create an empty RainfallRunoff object. " <<
@@ -37,7 +51,7 @@ void rainGrid::create(std::vector< std::vector<float> >& rain_data,
 {
   // Creates a 2D object of rainfall data based on the extents of the
   // current model domain, and the rainfall timeseries.
-  rainfallgrid2D = TNT::Array2D<double>(imax+2, jmax+2, 0.0);
+  rainfallgrid2D = TNT::Array2D<hydro_real>(imax+2, jmax+2, 0.0);
 
   // DEBUG
   if (rf_num == 1)
@@ -68,7 +82,7 @@ void rainGrid::create(std::vector< std::vector<float> >& rain_data,
 void rainGrid::create(TNT::Array3D<double>& rain_data, int current_raindata_timestep, int imax, int jmax)
 {
   //Ingest from netcdf file
-  rainfallgrid2D = TNT::Array2D<double>(imax+2,jmax+2, 0.0);
+  rainfallgrid2D = TNT::Array2D<hydro_real>(imax+2,jmax+2, 0.0);
 
   for (int i=1; i<imax; i++)
   {
@@ -93,7 +107,7 @@ void rainGrid::write_rainGrid_to_raster_file(double xmin,
   double nodata = -9999.0;
   
   LSDRaster output_raingrid(nrows, ncols, xmin, ymin, cellsize, nodata,
-                            rainfallgrid2D);
+                            to_double_array(rainfallgrid2D));
   output_raingrid.strip_raster_padding();
   output_raingrid.write_double_raster(RAINGRID_FNAME, RAINGRID_EXTENSION);
 }
@@ -124,11 +138,11 @@ void runoffGrid::create(int imax, int jmax)
   std::cout << "Creating an EMPTY RUNOFF GRID OBJECT..." << std::endl;
   // set arrays to relevant size for model domain
   // Zero or set to very small value near zero.
-  j_array = TNT::Array2D<double>(imax +2, jmax +2, 0.000000001);
-  jo_array = TNT::Array2D<double>(imax +2, jmax +2, 0.000000001);
-  j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
-  old_j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
-  new_j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
+  j_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.000000001);
+  jo_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.000000001);
+  j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
+  old_j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
+  new_j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
 
   // This is all that happens, use calculate_runoff() to fill in with proper values.
 
@@ -139,15 +153,15 @@ void runoffGrid::create(int imax, int jmax)
 void runoffGrid::create(int current_rainfall_timestep, int imax, int jmax,
                                 int rain_factor, double M,
                                 const rainGrid& current_rainGrid,
-                                const TNT::Array2D<double>& elevations)
+                                const LSDGrid<double>& elevations)
 {
   std::cout << "Creating a RUNOFF GRID OBJECT FROM RAINGRID..." << std::endl;
   // set arrays to relevant size for model domain
-  j_array = TNT::Array2D<double>(imax +2, jmax +2, 0.000000001);
-  jo_array = TNT::Array2D<double>(imax +2, jmax +2, 0.000000001);
-  j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
-  old_j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
-  new_j_mean_array = TNT::Array2D<double>(imax +2, jmax +2, 0.0);
+  j_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.000000001);
+  jo_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.000000001);
+  j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
+  old_j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
+  new_j_mean_array = TNT::Array2D<hydro_real>(imax +2, jmax +2, 0.0);
 
   calculate_runoff(rain_factor, M, jmax, imax, current_rainGrid, elevations);
 }
@@ -166,7 +180,7 @@ void runoffGrid::write_runoffGrid_to_raster_file(double xmin,
   int nodata = -9999;
   
   LSDRaster output_runoffgrid(nrows, ncols, xmin, ymin, cellsize, nodata,
-                            new_j_mean_array);
+                            to_double_array(new_j_mean_array));
   output_runoffgrid.strip_raster_padding();
   output_runoffgrid.write_double_raster(RUNOFFGRID_FNAME, RUNOFFGRID_EXTENSION); 
 }
@@ -174,7 +188,7 @@ void runoffGrid::write_runoffGrid_to_raster_file(double xmin,
 
 void runoffGrid::calculate_runoff(int rain_factor, double M, int jmax, int imax, 
                                   const rainGrid& current_rainGrid, 
-                                  const TNT::Array2D<double>& elevations)
+                                  const LSDGrid<double>& elevations)
 {
   //std::cout << "calculate_runoff" << std::endl;
   // DAV addeded pragma for testing 08/2016
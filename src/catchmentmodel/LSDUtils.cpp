@@ -4,6 +4,9 @@
 #include <iostream>
 #include <fstream>
 #include <ostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
 #include <sys/stat.h>
 #include <catchmentmodel/LSDUtils.hpp>
 
@@ -90,6 +93,18 @@ namespace LSDUtils
       return toRemove;
     }
 
+    std::vector<double> parse_number_list(const std::string& value)
+    {
+      std::vector<double> numbers;
+      std::stringstream list(value);
+      std::string item;
+      while (std::getline(list, item, ','))
+      {
+        if (!item.empty()) numbers.push_back(atof(item.c_str()));
+      }
+      return numbers;
+    }
+
     void quickOpenMPtest()
     {
       // test
@@ -154,15 +154,29 @@ int main(int argc, char *argv[])
     simulation.reach_water_and_sediment_input();
     // Add water to the catchment from rainfall input file
     simulation.catchment_waterinputs(runoff);
-    // Distribute the water with the LISFLOOD Cellular Automaton algorithm
-    simulation.flow_route();
-    // Groundwater updates
-    if (simulation.groundwater_mode())
+    if (simulation.hydro_frozen())
+    {
+      // The flow is quasi-steady: keep it, and only move the suspended
+      // sediment through it
+      simulation.route_suspended_sediment();
+    }
+    else if (simulation.hydro_step_fused())
+    {
+      // Flow routing and depth update in one pass
+      simulation.fused_hydro_step();
+    }
+    else
     {
-      simulation.wpgw_water_input(); // Is this the right arg?;
+      // Distribute the water with the LISFLOOD Cellular Automaton algorithm
+      simulation.flow_route();
+      // Groundwater updates
+      if (simulation.groundwater_mode())
+      {
+        simulation.wpgw_water_input(); // Is this the right arg?;
+      }
+      // Calculate the new water depths in the catchment
+      simulation.depth_update();
     }
-    // Calculate the new water depths in the catchment
-    simulation.depth_update();
 
     // Check wetted area
     // This masks a portion of the catchment that actually
@@ -178,6 +192,8 @@ int main(int argc, char *argv[])
       //simulation.call_lateral(); // not tested in this version!
     }
 
+    // Freeze the flow if it has stopped changing (or let it go again)
+    simulation.check_quasi_steady();
     // Water outputs from edges/catchment outlet
     simulation.water_flux_out();
 
@@ -204,6 +220,7 @@ int main(int argc, char *argv[])
   } while (simulation.get_cycle() / 60 < simulation.get_maxcycle());
 
   std::cout << "THE SIMULATION IS FINISHED!" << std::endl;
+  simulation.print_hydro_throughput();
 
   // Timing routine for parallel
   #ifdef OMP_COMPILE_FOR_PARALLEL
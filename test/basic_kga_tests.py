@@ -1,3 +1,4 @@
+import os
 import pytest
 import json
 import rasterio
@@ -11,8 +12,20 @@ Regression/functional tests for standard test cases
 of HAIL-CAESAR, comparing to Known Good Answers (KGA's)
 
 Based on Stuart Grieve's LSDTopoTools test framework.
+
+Set KGA_FIXTURES=single to check the single precision build's results
+(run_precision_tests.sh) instead. Float storage of the flow state moves
+the answers by rounding error, up to a few mm of depth, so those are
+compared with a looser tolerance.
 """
 
+FIXTURES = os.environ.get('KGA_FIXTURES', '')
+SUFFIX = '_' + FIXTURES if FIXTURES else ''
+if FIXTURES == 'single':
+    TOLERANCE = {'rtol': 2e-03, 'atol': 5e-03}
+else:
+    TOLERANCE = {'rtol': 1e-03}
+
 
 def raster(filename):
     """
@@ -37,7 +50,7 @@ def rasters_params():
     Pytest fixture that reads in paths containing results/KGAs
     and returns them as a list of params. (For rasters)
     """
-    with open('known_good_answers/rasters.json') as f:
+    with open('known_good_answers/rasters' + SUFFIX + '.json') as f:
         fixtures = json.loads(f.read())
     params = []
 
@@ -52,7 +65,7 @@ def timeseries_params():
     """
     Fixture for the timeseries files
     """
-    with open('known_good_answers/timeseries.json') as f:
+    with open('known_good_answers/timeseries' + SUFFIX + '.json') as f:
         fixtures = json.loads(f.read())
     params = []
 
@@ -67,9 +80,9 @@ class TestingHAILCAESAR():
     @staticmethod
     @pytest.mark.parametrize('result,expected', rasters_params())
     def test_water_depths(result, expected):
-        ntest.assert_allclose(result, expected, rtol=1e-03)
+        ntest.assert_allclose(result, expected, **TOLERANCE)
 
     @staticmethod
     @pytest.mark.parametrize('result,expected', timeseries_params())
     def test_hydrograph_lisflood(result, expected):
-        ntest.assert_allclose(result, expected, rtol=1e-03)
+        ntest.assert_allclose(result, expected, **TOLERANCE)
@@ -0,0 +1,161 @@
+#!/usr/bin/env bash
+# Hydro kernel throughput benchmark.
+#
+# Runs the Boscastle (catchment mode) and Caersws (reach mode) test inputs
+# with the default column-wise traversal, with row_major_traversal, and
+# with the vectorised flow kernels (simd_flow_route: auto), and prints the
+# wet cells/second reported by the model for each run. Boscastle is also
+# run with incremental_wet_scan to compare the time spent on wet area scans,
+# and with fused_hydro_step. Then the Boscastle hydro and erosion inputs
+# are run with the generic and the option-specialised kernels
+# (specialised_kernels), and the results printed as a table. Last, the
+# global landsliding is timed with full sweeps and with the worklist.
+#
+# Usage (from the test/ directory, after building with make):
+#   ./run_benchmarks.sh [model_hours]
+# model_hours defaults to 24 so the Caersws run (normally ~10 years) finishes.
+HOURS=${1:-24}
+BENCHDIR=./results/benchmarks
+mkdir -p $BENCHDIR
+
+# Writes a copy of a parameter file with the output path, run length and
+# traversal option overridden. Later lines in a parameter file take
+# precedence, so the overrides are simply appended.
+make_params()
+{
+  local src=$1 dest=$2 readpath=$3 writepath=$4 row_major=$5 simd=${6:-no} \
+        incremental=${7:-no}
+  mkdir -p $writepath
+  cp $src $dest
+  cat >> $dest <<EOF
+
+# BENCHMARK OVERRIDES
+read_path:                     $readpath
+write_path:                    $writepath
+max_run_duration:              $((HOURS - 1))
+debug_print_cycle:             no
+row_major_traversal:           $row_major
+simd_flow_route:               $simd
+incremental_wet_scan:          $incremental
+EOF
+}
+
+for order in no yes
+do
+  make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u.params \
+    $BENCHDIR/boscastle_rowmajor_$order.params \
+    ./input_data/boscastle/boscastle_input_data/ \
+    $BENCHDIR/boscastle_rowmajor_$order/ $order
+  echo "Boscastle 50m, row_major_traversal: $order"
+  ../bin/HAIL-CAESAR.exe $BENCHDIR/ boscastle_rowmajor_$order.params \
+    | grep "Hydro kernels\|Wet area scans\|simulation ran in"
+
+  make_params ./input_data/caersws/Caersws.params \
+    $BENCHDIR/caersws_rowmajor_$order.params \
+    ./input_data/caersws/ \
+    $BENCHDIR/caersws_rowmajor_$order/ $order
+  echo "Caersws reach, row_major_traversal: $order"
+  ../bin/HAIL-CAESAR.exe $BENCHDIR/ caersws_rowmajor_$order.params \
+    | grep "Hydro kernels\|Wet area scans\|simulation ran in"
+done
+
+make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u.params \
+  $BENCHDIR/boscastle_simd.params \
+  ./input_data/boscastle/boscastle_input_data/ \
+  $BENCHDIR/boscastle_simd/ yes auto
+echo "Boscastle 50m, simd_flow_route: auto"
+../bin/HAIL-CAESAR.exe $BENCHDIR/ boscastle_simd.params \
+  | grep "instruction set\|Hydro kernels\|simulation ran in"
+
+make_params ./input_data/caersws/Caersws.params \
+  $BENCHDIR/caersws_simd.params \
+  ./input_data/caersws/ \
+  $BENCHDIR/caersws_simd/ yes auto
+echo "Caersws reach, simd_flow_route: auto"
+../bin/HAIL-CAESAR.exe $BENCHDIR/ caersws_simd.params \
+  | grep "instruction set\|Hydro kernels\|simulation ran in"
+
+for incremental in no yes
+do
+  make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u.params \
+    $BENCHDIR/boscastle_incremental_$incremental.params \
+    ./input_data/boscastle/boscastle_input_data/ \
+    $BENCHDIR/boscastle_incremental_$incremental/ no no $incremental
+  echo "Boscastle 50m, incremental_wet_scan: $incremental"
+  ../bin/HAIL-CAESAR.exe $BENCHDIR/ boscastle_incremental_$incremental.params \
+    | grep "Wet area scans\|active (wet list) fraction\|simulation ran in"
+done
+
+make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u.params \
+  $BENCHDIR/boscastle_fused.params \
+  ./input_data/boscastle/boscastle_input_data/ \
+  $BENCHDIR/boscastle_fused/ yes
+echo "fused_hydro_step:              yes" >> $BENCHDIR/boscastle_fused.params
+echo "Boscastle 50m, fused_hydro_step: yes"
+../bin/HAIL-CAESAR.exe $BENCHDIR/ boscastle_fused.params \
+  | grep "Hydro kernels\|simulation ran in"
+
+# Generic vs option-specialised kernels
+RESULTS=""
+for input in boscastle_test_72hr_50m_u boscastle_test_72hr_50m_u_erosion
+do
+  for specialised in no yes
+  do
+    name=${input}_specialised_$specialised
+    make_params ./input_data/boscastle/boscastle_input_data/$input.params \
+      $BENCHDIR/$name.params \
+      ./input_data/boscastle/boscastle_input_data/ \
+      $BENCHDIR/$name/ no
+    echo "specialised_kernels:           $specialised" >> $BENCHDIR/$name.params
+    ../bin/HAIL-CAESAR.exe $BENCHDIR/ $name.params > $BENCHDIR/$name.log
+    rate=$(sed -n 's/^Hydro kernels.*(\(.*\) cells\/s)$/\1/p' $BENCHDIR/$name.log)
+    erosion=$(sed -n 's/^Erosion (.*): \(.*\) s$/\1/p' $BENCHDIR/$name.log)
+    total=$(sed -n 's/^The simulation ran in \([^ ]*\) minutes.*/\1/p' \
+            $BENCHDIR/$name.log)
+    RESULTS="$RESULTS$(printf "%-36s %-12s %14s %12s %10s" $input $specialised \
+             $rate ${erosion:--} $total)\n"
+  done
+done
+echo
+printf "%-36s %-12s %14s %12s %10s\n" "Input" "Specialised" "Hydro cells/s" \
+  "Erosion (s)" "Total (min)"
+printf "$RESULTS"
+
+# Global landsliding with full sweeps vs the worklist. A low failure angle
+# gives the landslide routine plenty to do on the Boscastle DEM.
+echo
+for worklist in no yes
+do
+  name=boscastle_landslide_worklist_$worklist
+  make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u_erosion.params \
+    $BENCHDIR/$name.params \
+    ./input_data/boscastle/boscastle_input_data/ \
+    $BENCHDIR/$name/ no
+  cat >> $BENCHDIR/$name.params <<PARAMS
+slope_failure_thresh:          15
+landslide_worklist:            $worklist
+PARAMS
+  echo "Boscastle 50m erosion, slope_failure_thresh: 15, landslide_worklist: $worklist"
+  ../bin/HAIL-CAESAR.exe $BENCHDIR/ $name.params \
+    | grep "Global landsliding\|simulation ran in"
+done
+
+# Explicit vs implicit creep, with month long steps at a creep rate the
+# explicit step cannot take stably.
+echo
+for implicit in no yes
+do
+  name=boscastle_implicit_creep_$implicit
+  make_params ./input_data/boscastle/boscastle_input_data/boscastle_test_72hr_50m_u_erosion.params \
+    $BENCHDIR/$name.params \
+    ./input_data/boscastle/boscastle_input_data/ \
+    $BENCHDIR/$name/ no
+  cat >> $BENCHDIR/$name.params <<PARAMS
+creep_rate:                    50000
+creep_interval_days:           30
+implicit_creep:                $implicit
+PARAMS
+  echo "Boscastle 50m erosion, creep_rate: 50000, creep_interval_days: 30, implicit_creep: $implicit"
+  ../bin/HAIL-CAESAR.exe $BENCHDIR/ $name.params \
+    | grep "^Creep (\|simulation ran in"
+done
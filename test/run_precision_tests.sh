@@ -0,0 +1,31 @@
+#!/usr/bin/env bash
+# Single precision comparison run.
+#
+# Runs the Boscastle tests of run_tests.sh with the single precision build
+# (make PRECISION=single, bin/HAIL-CAESAR-sp.exe), writing into
+# results/*_single so the double precision results are left alone. The
+# results can then be checked against the same known good answers with:
+#   KGA_FIXTURES=single pytest basic_kga_tests.py
+#
+# Usage (from the test/ directory, after make PRECISION=single):
+#   ./run_precision_tests.sh
+READPATH=./input_data/boscastle/boscastle_input_data/
+PARAMDIR=./results/precision
+mkdir -p $PARAMDIR
+
+for test in boscastle_test_72hr_50m_u:boscastle50m_72_u \
+            boscastle_test_72hr_50m_u_flipped_lr:boscastle50m_72_u_flipped_lr
+do
+  params=${test%%:*}
+  writepath=./results/${test##*:}_single/
+  mkdir -p $writepath
+  # Later lines in a parameter file take precedence
+  cp $READPATH/$params.params $PARAMDIR/$params.params
+  cat >> $PARAMDIR/$params.params <<EOF
+
+# PRECISION TEST OVERRIDES
+read_path:                     $READPATH
+write_path:                    $writepath
+EOF
+  ../bin/HAIL-CAESAR-sp.exe $PARAMDIR/ $params.params
+done
@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+# Thread scaling benchmark for the work schedules.
+#
+# Runs the Boscastle hydro and erosion inputs with each work_schedule
+# (static, weighted, dynamic) at a range of OpenMP thread counts, and
+# prints the hydro kernel throughput, the time spent in erosion and the
+# total run time of each run as a table. The speedup is the total run
+# time of the single thread static run over that of the run. A second
+# table times in_channel_landsliding() with and without
+# coloured_channel_landsliding.
+#
+# Usage (from the test/ directory, after building with make):
+#   ./run_scaling_benchmark.sh [model_hours] [thread counts...]
+# model_hours defaults to 24, the thread counts to 1, 2, 4... up to the
+# number of processors.
+HOURS=${1:-24}
+shift
+THREADS=${@:-$(n=1; while [ $n -le $(nproc) ]; do echo $n; n=$((n * 2)); done)}
+BENCHDIR=./results/scaling
+READPATH=./input_data/boscastle/boscastle_input_data/
+mkdir -p $BENCHDIR
+
+# Writes a copy of a parameter file with the output path, run length and
+# schedule overridden. Later lines in a parameter file take precedence.
+make_params()
+{
+  local src=$1 dest=$2 writepath=$3 schedule=$4
+  mkdir -p $writepath
+  cp $src $dest
+  cat >> $dest <<EOF
+
+# BENCHMARK OVERRIDES
+read_path:                     $READPATH
+write_path:                    $writepath
+max_run_duration:              $((HOURS - 1))
+debug_print_cycle:             no
+work_schedule:                 $schedule
+EOF
+}
+
+printf "%-36s %8s %-10s %14s %12s %10s %8s\n" "Input" "Threads" "Schedule" \
+  "Hydro cells/s" "Erosion (s)" "Total (min)" "Speedup"
+for input in boscastle_test_72hr_50m_u boscastle_test_72hr_50m_u_erosion
+do
+  base=""
+  for threads in $THREADS
+  do
+    for schedule in static weighted dynamic
+    do
+      name=${input}_${threads}_$schedule
+      make_params $READPATH/$input.params $BENCHDIR/$name.params \
+        $BENCHDIR/$name/ $schedule
+      OMP_NUM_THREADS=$threads ../bin/HAIL-CAESAR.exe $BENCHDIR/ $name.params \
+        > $BENCHDIR/$name.log
+      rate=$(sed -n 's/^Hydro kernels.*(\(.*\) cells\/s)$/\1/p' $BENCHDIR/$name.log)
+      erosion=$(sed -n 's/^Erosion (.*): \(.*\) s$/\1/p' $BENCHDIR/$name.log)
+      total=$(sed -n 's/^The simulation ran in \([^ ]*\) minutes.*/\1/p' \
+              $BENCHDIR/$name.log)
+      base=${base:-$total}
+      speedup=$(awk -v b=$base -v t=$total 'BEGIN { printf "%.2f", b / t }')
+      printf "%-36s %8s %-10s %14s %12s %10s %8s\n" $input $threads $schedule \
+        $rate ${erosion:--} $total $speedup
+    done
+  done
+done
+
+# In-channel landsliding, serial vs by colour classes
+# (coloured_channel_landsliding). A low failure angle gives it plenty of
+# slides to do.
+echo
+printf "%-36s %8s %-10s %16s %10s\n" "Input" "Threads" "Coloured" \
+  "Landsliding (s)" "Total (min)"
+input=boscastle_test_72hr_50m_u_erosion
+for threads in $THREADS
+do
+  for coloured in no yes
+  do
+    name=${input}_${threads}_coloured_$coloured
+    make_params $READPATH/$input.params $BENCHDIR/$name.params \
+      $BENCHDIR/$name/ static
+    cat >> $BENCHDIR/$name.params <<EOF
+slope_failure_thresh:          15
+coloured_channel_landsliding:  $coloured
+EOF
+    OMP_NUM_THREADS=$threads ../bin/HAIL-CAESAR.exe $BENCHDIR/ $name.params \
+      > $BENCHDIR/$name.log
+    slides=$(sed -n 's/^In-channel landsliding (.*): \(.*\) s$/\1/p' $BENCHDIR/$name.log)
+    total=$(sed -n 's/^The simulation ran in \([^ ]*\) minutes.*/\1/p' \
+            $BENCHDIR/$name.log)
+    printf "%-36s %8s %-10s %16s %10s\n" $input $threads $coloured $slides $total
+  done
+done